@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
+
+// Process launch benchmark for the pmake executable
+//
+// Usage: startup_bench [--runs <n>] [--warmup <n>] [--json <file>] -- <program> [args...]
+//
+// The program is started <runs> times after <warmup> discarded launches, with
+// stdout and stderr sent to the null device, and the wall time from spawn to
+// exit is reported as min/percentiles/max. Set PMAKE_TRACE_STARTUP=1 on a
+// single manual run to see where the time inside the process goes.
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+std::string quoteArg(const std::string &arg)
+{
+	if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+		return arg;
+	std::string out = "\"";
+	size_t slashes  = 0;
+	for (char c : arg)
+	{
+		if (c == '\\')
+		{
+			++slashes;
+			continue;
+		}
+		out.append(c == '"' ? slashes * 2 + 1 : slashes, '\\');
+		slashes = 0;
+		out += c;
+	}
+	out.append(slashes * 2, '\\');
+	return out + "\"";
+}
+
+// Launch the command and wait for it; returns the exit code or -1
+int launch(const std::vector<std::string> &command)
+{
+	std::string line;
+	for (const auto &arg : command)
+		line += (line.empty() ? "" : " ") + quoteArg(arg);
+
+	SECURITY_ATTRIBUTES inherit{sizeof(inherit), nullptr, TRUE};
+	HANDLE nul = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &inherit, OPEN_EXISTING, 0, nullptr);
+	STARTUPINFOA startup{};
+	startup.cb         = sizeof(startup);
+	startup.dwFlags    = STARTF_USESTDHANDLES;
+	startup.hStdInput  = GetStdHandle(STD_INPUT_HANDLE);
+	startup.hStdOutput = nul;
+	startup.hStdError  = nul;
+	PROCESS_INFORMATION process{};
+	BOOL ok = CreateProcessA(nullptr, line.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process);
+	CloseHandle(nul);
+	if (!ok)
+		return -1;
+	WaitForSingleObject(process.hProcess, INFINITE);
+	DWORD code = 0;
+	GetExitCodeProcess(process.hProcess, &code);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+	return static_cast<int>(code);
+}
+#else
+extern "C" char **environ;
+
+// Launch the command and wait for it; returns the exit code or -1
+int launch(const std::vector<std::string> &command)
+{
+	std::vector<char *> argv;
+	for (const auto &arg : command)
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+	pid_t pid;
+	int err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (err != 0)
+		return -1;
+	int status = 0;
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+		return -1;
+	return WEXITSTATUS(status);
+}
+#endif
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+	double rank = p / 100.0 * static_cast<double>(sorted.size() - 1);
+	size_t lo   = static_cast<size_t>(rank);
+	size_t hi   = std::min(lo + 1, sorted.size() - 1);
+	return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - static_cast<double>(lo));
+}
+
+void usage()
+{
+	std::fprintf(stderr, "usage: startup_bench [--runs <n>] [--warmup <n>] [--json <file>] -- <program> [args...]\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	int runs = 50, warmup = 5;
+	const char *jsonPath = nullptr;
+	std::vector<std::string> command;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--") == 0)
+		{
+			command.assign(argv + i + 1, argv + argc);
+			break;
+		}
+		if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+			runs = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (command.empty() || runs < 1 || warmup < 0)
+	{
+		usage();
+		return 1;
+	}
+
+	int exitCode = 0;
+	for (int i = 0; i < warmup; ++i)
+		exitCode = launch(command);
+
+	std::vector<double> samples;
+	samples.reserve(runs);
+	for (int i = 0; i < runs; ++i)
+	{
+		auto start = Clock::now();
+		exitCode   = launch(command);
+		samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		if (exitCode < 0)
+		{
+			std::fprintf(stderr, "failed to launch %s\n", command[0].c_str());
+			return 1;
+		}
+	}
+	std::sort(samples.begin(), samples.end());
+
+	struct Stat
+	{
+		const char *name;
+		double ms;
+	};
+	const Stat stats[] = {
+	    {"min", samples.front()},
+	    {"p50", percentile(samples, 50)},
+	    {"p90", percentile(samples, 90)},
+	    {"p99", percentile(samples, 99)},
+	    {"max", samples.back()},
+	};
+
+	std::printf("%s: %d runs, exit code %d\n", command[0].c_str(), runs, exitCode);
+	for (const auto &s : stats)
+		std::printf("  %-4s %10.3f ms\n", s.name, s.ms);
+
+	if (jsonPath)
+	{
+		std::FILE *out = std::fopen(jsonPath, "w");
+		if (!out)
+		{
+			std::fprintf(stderr, "Failed to write %s\n", jsonPath);
+			return 1;
+		}
+		// Same Google Benchmark layout as value_bench, one entry per statistic
+		std::fprintf(out, "{\n  \"context\": {\"executable\": \"startup_bench\"},\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < std::size(stats); ++i)
+			std::fprintf(out,
+			             "    {\"name\": \"startup/%s\", \"iterations\": %d, \"real_time\": %.3f, "
+			             "\"cpu_time\": %.3f, \"time_unit\": \"ms\"}%s\n",
+			             stats[i].name, runs, stats[i].ms, stats[i].ms, i + 1 < std::size(stats) ? "," : "");
+		std::fprintf(out, "  ]\n}\n");
+		if (std::fclose(out) != 0)
+		{
+			std::fprintf(stderr, "Failed to write %s\n", jsonPath);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,593 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ArrayBuiltins.hpp>
+#include <Serialize.hpp>
+#include <Value.hpp>
+#include <ValueMap.hpp>
+
+// Micro-benchmarks for include/Value.hpp
+//
+// Usage: value_bench [--filter <substring>] [--min-time <seconds>] [--json <file>]
+//
+// Each benchmark is run with a doubling iteration count until one batch takes
+// at least the minimum time; the best of five such batches is reported. The
+// JSON file uses the same layout as Google Benchmark so existing comparison
+// tooling can read it.
+
+using namespace Phasor;
+
+namespace
+{
+
+// Keep the optimizer from discarding a computed value
+template <typename T> void keep(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "m"(value) : "memory");
+#else
+	static const void *volatile sink;
+	sink = &value;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Escape a string for a JSON string literal
+std::string jsonEscape(std::string_view s)
+{
+	std::string out;
+	out.reserve(s.size());
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out += std::format("\\u{:04x}", static_cast<unsigned>(c));
+		else
+			out += c;
+	}
+	return out;
+}
+
+struct Result
+{
+	std::string name;
+	uint64_t    iterations;
+	double      nsPerOp;
+};
+
+struct Options
+{
+	std::string filter;
+	std::string json;
+	double      minTime = 0.2;
+};
+
+class Runner
+{
+  public:
+	explicit Runner(Options options) : options(std::move(options))
+	{
+	}
+
+	// `body(n)` must perform n operations. Bodies that work in batches of
+	// `batch` elements get n as a whole number of batches, so every result
+	// is time per element
+	void run(const std::string &name, const std::function<void(uint64_t)> &body, uint64_t batch = 1)
+	{
+		if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+			return;
+
+		using Clock  = std::chrono::steady_clock;
+		auto elapsed = [&](uint64_t n) {
+			auto start = Clock::now();
+			body(n);
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		};
+
+		uint64_t n = batch;
+		while (elapsed(n) < options.minTime && n < (uint64_t(1) << 40))
+			n *= 2;
+
+		double best = elapsed(n);
+		for (int i = 0; i < 4; ++i)
+			best = std::min(best, elapsed(n));
+
+		Result r{name, n, best * 1e9 / static_cast<double>(n)};
+		std::printf("%-44s %14.2f ns/op %14llu iterations\n", r.name.c_str(), r.nsPerOp,
+		            static_cast<unsigned long long>(r.iterations));
+		results.push_back(std::move(r));
+	}
+
+	bool writeJson() const
+	{
+		if (options.json.empty())
+			return true;
+		FILE *f = std::fopen(options.json.c_str(), "w");
+		if (!f)
+			return false;
+		std::string out = "{\n  \"context\": {\"executable\": \"value_bench\"},\n  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &r = results[i];
+			out += std::format("    {{\"name\": \"{}\", \"iterations\": {}, \"real_time\": {:.3f}, "
+			                   "\"cpu_time\": {:.3f}, \"time_unit\": \"ns\"}}{}\n",
+			                   jsonEscape(r.name), r.iterations, r.nsPerOp, r.nsPerOp,
+			                   i + 1 < results.size() ? "," : "");
+		}
+		out += "  ]\n}\n";
+		bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+		return std::fclose(f) == 0 && ok;
+	}
+
+  private:
+	Options             options;
+	std::vector<Result> results;
+};
+
+void constructionAndCopy(Runner &bench)
+{
+	bench.run("construct/null", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value());
+	});
+	bench.run("construct/int", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value(static_cast<int64_t>(i)));
+	});
+	bench.run("construct/string_short", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value("preset"));
+	});
+	std::string longText(256, 'x');
+	bench.run("construct/string_long", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value(longText));
+	});
+	bench.run("construct/struct", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value::createStruct("Config"));
+	});
+	bench.run("construct/array_8_int", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(Value::createArray({1, 2, 3, 4, 5, 6, 7, 8}));
+	});
+
+	Value i(42), s("a short string"), l(longText), arr = Value::createArray({1, 2, 3}), st = Value::createStruct("S");
+	bench.run("copy/int", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = i;
+			keep(c);
+		}
+	});
+	bench.run("copy/string_short", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = s;
+			keep(c);
+		}
+	});
+	bench.run("copy/string_long", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = l;
+			keep(c);
+		}
+	});
+	bench.run("copy/string_slice", [&](uint64_t n) {
+		Value slice = l.substr(0, 128);
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = slice;
+			keep(c);
+		}
+	});
+	bench.run("copy/array", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = arr;
+			keep(c);
+		}
+	});
+	bench.run("copy/struct", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			Value c = st;
+			keep(c);
+		}
+	});
+}
+
+void arithmetic(Runner &bench)
+{
+	struct Pair
+	{
+		const char *name;
+		Value       lhs, rhs;
+	};
+	const Pair pairs[] = {
+	    {"int_int", Value(7), Value(3)},
+	    {"int_float", Value(7), Value(3.5)},
+	    {"float_int", Value(7.5), Value(3)},
+	    {"float_float", Value(7.5), Value(3.5)},
+	};
+	for (const auto &p : pairs)
+	{
+		bench.run(std::format("arith/add/{}", p.name), [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				keep(p.lhs + p.rhs);
+		});
+		bench.run(std::format("arith/mul/{}", p.name), [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				keep(p.lhs * p.rhs);
+		});
+		bench.run(std::format("arith/div/{}", p.name), [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				keep(p.lhs / p.rhs);
+		});
+	}
+	Value a("configure"), b("/CMakeBuild");
+	bench.run("arith/add/string_string", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(a + b);
+	});
+}
+
+void strings(Runner &bench)
+{
+	for (uint64_t pieces : {16, 1024, 16384})
+	{
+		bench.run(std::format("string/concat_loop/{}", pieces), [=](uint64_t n) {
+			Value piece(" -DOPTION=ON");
+			for (uint64_t i = 0; i < n; i += pieces)
+			{
+				Value s("cmake");
+				for (uint64_t k = 0; k < pieces; ++k)
+					s = s + piece;
+				keep(s);
+			}
+		}, pieces);
+	}
+
+	std::string text;
+	for (int i = 0; i < 1000; ++i)
+		text += std::format("line {} of a generated file with some padding text\n", i);
+	Value file(text);
+	bench.run("string/substr_64", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(file.substr(i % 1000, 64));
+	});
+	bench.run("string/split_lines_1000", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 1000)
+			keep(file.splitLines());
+	}, 1000);
+	bench.run("string/starts_with", [&](uint64_t n) {
+		Value arg("--install");
+		for (uint64_t i = 0; i < n; ++i)
+			keep(arg.startsWith("-"));
+	});
+
+	std::string clean(4096, 'a'), dirty;
+	for (int i = 0; i < 4096; ++i)
+		dirty += i % 16 ? 'a' : '\n';
+	bench.run("string/escape_clean_4k", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 4096)
+			keep(escapeString(clean));
+	}, 4096);
+	bench.run("string/escape_dirty_4k", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 4096)
+			keep(escapeString(dirty));
+	}, 4096);
+}
+
+void comparison(Runner &bench)
+{
+	Value i1(10), i2(20), s1("--build"), s2("--install");
+	bench.run("compare/eq/int", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(i1 == i2);
+	});
+	bench.run("compare/lt/int", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(i1 < i2);
+	});
+	bench.run("compare/eq/string", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(s1 == s2);
+	});
+	bench.run("compare/lt/string", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(s1 < s2);
+	});
+}
+
+void structs(Runner &bench)
+{
+	Value cfg = Value::createStruct("Config");
+	for (const char *field : {"name", "version", "src", "build", "install", "preset"})
+		cfg.setField(field, Value(field));
+
+	bench.run("struct/get", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(cfg.getField("preset"));
+	});
+	bench.run("struct/set", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			cfg.setField("preset", Value(static_cast<int64_t>(i)));
+	});
+	FieldCache::stats().reset();
+	bench.run("struct/get_cached", [&](uint64_t n) {
+		FieldCache site("preset");
+		for (uint64_t i = 0; i < n; ++i)
+			keep(cfg.getField(site));
+	});
+	bench.run("struct/set_cached", [&](uint64_t n) {
+		FieldCache site("preset");
+		for (uint64_t i = 0; i < n; ++i)
+			cfg.setField(site, Value(static_cast<int64_t>(i)));
+	});
+	std::printf("  field cache hit rate %.4f\n", FieldCache::stats().hitRate());
+}
+
+void arrays(Runner &bench)
+{
+	bench.run("array/append_int", [](uint64_t n) {
+		Value arr = Value::createArray();
+		for (uint64_t i = 0; i < n; ++i)
+			arr.pushElement(Value(static_cast<int64_t>(i)));
+		keep(arr);
+	});
+	bench.run("array/append_string", [](uint64_t n) {
+		Value arr = Value::createArray();
+		Value s("target");
+		for (uint64_t i = 0; i < n; ++i)
+			arr.pushElement(s);
+		keep(arr);
+	});
+
+	std::vector<Value> ints, mixed;
+	for (int64_t i = 0; i < 100000; ++i)
+	{
+		ints.push_back(Value(i));
+		mixed.push_back(i % 2 ? Value(i) : Value(static_cast<double>(i)));
+	}
+	Value packed = Value::createArray(ints), generic = Value::createArray(mixed);
+	Value packed2 = Value::createArray(ints);
+	bench.run("array/index_packed", [&](uint64_t n) {
+		const auto &arr = *packed.asArray();
+		for (uint64_t i = 0; i < n; ++i)
+			keep(arr[i % arr.size()]);
+	});
+	bench.run("array/index_generic", [&](uint64_t n) {
+		const auto &arr = *generic.asArray();
+		for (uint64_t i = 0; i < n; ++i)
+			keep(arr[i % arr.size()]);
+	});
+
+	// Kernel throughput against the per-Value loop it replaces, per element
+	bench.run("array/sum_100k/simd", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(builtins::array_sum(packed));
+	}, 100000);
+	bench.run("array/sum_100k/per_value", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+		{
+			Value sum(0);
+			for (const auto &v : ints)
+				sum = sum + v;
+			keep(sum);
+		}
+	}, 100000);
+	bench.run("array/equal_100k/simd", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(packed == packed2);
+	}, 100000);
+	bench.run("array/equal_100k/per_value", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(std::equal(ints.begin(), ints.end(), ints.begin()));
+	}, 100000);
+	bench.run("array/max_100k/simd", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(builtins::array_max(packed));
+	}, 100000);
+	bench.run("array/find_100k/simd", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(builtins::array_find(packed, Value(int64_t(99999))));
+	}, 100000);
+	bench.run("array/find_100k/per_value", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(std::find(ints.begin(), ints.end(), Value(int64_t(99999))));
+	}, 100000);
+	bench.run("array/add_100k/simd", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+			keep(builtins::array_add(packed, packed2));
+	}, 100000);
+
+	// Sorting includes copying the shuffled input back in each round
+	std::vector<Value> shuffled = ints, names;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(1));
+	for (const auto &v : shuffled)
+		names.push_back(Value(std::format("src/module_{}.cpp", v.asInt())));
+	bench.run("array/sort_100k/packed", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+		{
+			Value arr = Value::createArray(shuffled);
+			keep(builtins::array_sort(arr));
+		}
+	}, 100000);
+	bench.run("array/sort_100k/per_value", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+		{
+			std::vector<Value> arr = shuffled;
+			std::sort(arr.begin(), arr.end());
+			keep(arr);
+		}
+	}, 100000);
+	bench.run("array/sort_100k/strings", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 100000)
+		{
+			Value arr = Value::createArray(names);
+			keep(builtins::array_stable_sort(arr));
+		}
+	}, 100000);
+	bench.run("array/search_100k/packed", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			keep(builtins::array_search(packed, Value(static_cast<int64_t>(i % 100000))));
+	});
+}
+
+void formatting(Runner &bench)
+{
+	Value i(1234567), f(3.14159), s("src/utils/pmake/main.phs");
+	Value arr = Value::createArray({Value("a"), Value(1), Value(2.5), Value::createArray({true, false})});
+	Value cfg = Value::createStruct("Config");
+	cfg.setField("name", "pmake");
+	cfg.setField("files", arr);
+
+	bench.run("toString/int", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(i.toString());
+	});
+	bench.run("toString/float", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(f.toString());
+	});
+	bench.run("toString/array", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(arr.toString());
+	});
+	bench.run("format/int", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(std::format("{}", i));
+	});
+	bench.run("format/string_quoted", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(std::format("{:q}", s));
+	});
+	bench.run("format/struct_debug", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(std::format("{:?}", cfg));
+	});
+	bench.run("format/array_padded", [&](uint64_t n) {
+		for (uint64_t k = 0; k < n; ++k)
+			keep(std::format("{:>40}", arr));
+	});
+}
+
+void hashing(Runner &bench)
+{
+	std::vector<Value> intKeys, stringKeys;
+	for (int64_t i = 0; i < 10000; ++i)
+	{
+		intKeys.push_back(Value(i * 7919));
+		stringKeys.push_back(Value(std::format("src/module_{}/file_{}.cpp", i % 97, i)));
+	}
+
+	for (auto [name, keys] : {std::pair{"int", &intKeys}, std::pair{"string", &stringKeys}})
+	{
+		bench.run(std::format("hash/{}", name), [&, keys](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				keep((*keys)[i % keys->size()].hash());
+		});
+		bench.run(std::format("map/insert_10k/{}", name), [&, keys](uint64_t n) {
+			for (uint64_t i = 0; i < n; i += keys->size())
+			{
+				ValueMap map;
+				for (const auto &k : *keys)
+					map.set(k, Value(true));
+				keep(map);
+			}
+		}, keys->size());
+		ValueMap map;
+		for (const auto &k : *keys)
+			map.set(k, Value(true));
+		bench.run(std::format("map/lookup/{}", name), [&, keys](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				keep(map.find((*keys)[i % keys->size()]));
+		});
+		bench.run(std::format("map/linear_scan_10k/{}", name), [&, keys](uint64_t n) {
+			const Value &needle = keys->back();
+			for (uint64_t i = 0; i < n; i += keys->size())
+				keep(std::find(keys->begin(), keys->end(), needle));
+		}, keys->size());
+	}
+}
+
+void serialization(Runner &bench)
+{
+	Value cache = Value::createStruct("Cache");
+	std::vector<Value> files;
+	for (int i = 0; i < 1000; ++i)
+		files.push_back(Value(std::format("/home/build/project/src/component_{}/source_file_{}.cpp", i % 13, i)));
+	cache.setField("files", Value::createArray(std::move(files)));
+	std::string bytes = serial::encode(cache);
+
+	bench.run("serialize/encode_1k_paths", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 1000)
+			keep(serial::encode(cache));
+	}, 1000);
+	bench.run("serialize/decode_1k_paths/copy", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 1000)
+			keep(serial::decode(bytes));
+	}, 1000);
+	auto owner = std::make_shared<std::string>(bytes);
+	bench.run("serialize/decode_1k_paths/zero_copy", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; i += 1000)
+			keep(serial::decode(*owner, owner));
+	}, 1000);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc)
+			options.filter = argv[++i];
+		else if (arg == "--json" && i + 1 < argc)
+			options.json = argv[++i];
+		else if (arg == "--min-time" && i + 1 < argc)
+			options.minTime = std::atof(argv[++i]);
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time <seconds>] [--json <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Runner bench(options);
+	constructionAndCopy(bench);
+	arithmetic(bench);
+	strings(bench);
+	comparison(bench);
+	structs(bench);
+	arrays(bench);
+	formatting(bench);
+	hashing(bench);
+	serialization(bench);
+
+	if (!bench.writeJson())
+	{
+		std::fprintf(stderr, "Failed to write %s\n", options.json.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -1,9 +1,10 @@
 #include <pmake.hpp>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <string>
@@ -15,16 +16,101 @@
 extern "C" int exec(void *state, const unsigned char embeddedBytecode[], size_t embeddedBytecodeSize,
                     const char *moduleName, int argc, const char *argv[]);
 
+namespace
+{
+using StartupClock = std::chrono::steady_clock;
+
+/// @brief Startup phase timestamps, reported on stderr when PMAKE_TRACE_STARTUP=1
+///
+/// Phases inside exec() (module registration, project and cache reads) belong
+/// to the runtime and show up as one span here.
+class StartupTrace
+{
+  public:
+	explicit StartupTrace(bool enabled) : on(enabled)
+	{
+	}
+
+	bool enabled() const
+	{
+		return on;
+	}
+
+	/// @brief Record a phase boundary; does nothing, not even a clock read, when off
+	void mark(const char *phase)
+	{
+		if (!on)
+			return;
+		if (count < marks.size())
+			marks[count++] = {phase, StartupClock::now()};
+	}
+
+	void report() const
+	{
+		std::fprintf(stderr, "pmake startup trace (ms):\n");
+		for (size_t i = 1; i < count; ++i)
+			std::fprintf(stderr, "  %-14s -> %-14s %10.3f\n", marks[i - 1].phase, marks[i].phase,
+			             elapsedMs(marks[i - 1].time, marks[i].time));
+		std::fprintf(stderr, "  %-32s %10.3f\n", "total", elapsedMs(marks[0].time, marks[count - 1].time));
+	}
+
+  private:
+	struct Mark
+	{
+		const char *phase;
+		StartupClock::time_point time;
+	};
+
+	static double elapsedMs(StartupClock::time_point from, StartupClock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+	bool on;
+	std::array<Mark, 8> marks{};
+	size_t count = 0;
+};
+
+bool traceStartup()
+{
+	const char *value = std::getenv("PMAKE_TRACE_STARTUP");
+	return value && value[0] == '1';
+}
+
+// Constructed during static initialization, before main; the environment is
+// read only here
+StartupTrace startupTrace = [] {
+	StartupTrace trace(traceStartup());
+	trace.mark("static init");
+	return trace;
+}();
+
+void reportStartupTrace()
+{
+	startupTrace.mark("exit");
+	startupTrace.report();
+}
+} // namespace
+
 // Main entry point
 int main(int argc, char *argv[], char *envp[])
 {
+	// Reported from atexit so scripts that end through exit() are covered too
+	if (startupTrace.enabled())
+	{
+		startupTrace.mark("main");
+		std::atexit(reportStartupTrace);
+	}
     try
 	{
-        return exec(nullptr, embeddedBytecode, embeddedBytecodeSize, moduleName.c_str(), argc, (const char **)argv);
+        int result = exec(nullptr, embeddedBytecode, embeddedBytecodeSize, moduleName.c_str(), argc, (const char **)argv);
+		startupTrace.mark("exec returned");
+		return result;
 	}
 	catch (const std::exception &e)
 	{
-		std::cerr << "Runtime Error: " << e.what() << "\n";
+		startupTrace.mark("exec threw");
+		std::fprintf(stderr, "Runtime Error: %s\n", e.what());
 	}
 	return -1;
 }
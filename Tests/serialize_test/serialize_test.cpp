@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <Serialize.hpp>
+#include <Value.hpp>
+
+// Loads a serialized graph, saves a different one over the same path while
+// strings from the first load still slice its mapping, and reads them back.
+//
+// save() used to truncate the file in place, which shrank it under the live
+// mapping; touching an old slice then raised SIGBUS.
+
+using namespace Phasor;
+
+namespace
+{
+
+int checks   = 0;
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	++checks;
+	if (!ok)
+	{
+		++failures;
+		std::fprintf(stderr, "FAIL %s\n", what);
+	}
+}
+
+std::string path(int i)
+{
+	return "/home/build/project/src/component_" + std::to_string(i % 13) + "/source_file_" + std::to_string(i) +
+	       ".cpp";
+}
+
+Value graph(int files)
+{
+	std::vector<Value> paths;
+	for (int i = 0; i < files; ++i)
+		paths.push_back(Value(path(i)));
+	Value cache = Value::createStruct("Cache");
+	cache.setField("files", Value::createArray(std::move(paths)));
+	return cache;
+}
+
+} // namespace
+
+int main()
+{
+	std::string file = (std::filesystem::temp_directory_path() / "phasor_serialize_test.phsv").string();
+
+	check(serial::save(file, graph(2000)), "save large graph");
+	Value loaded = serial::load(file);
+	Value files  = loaded.getField("files");
+	check(files.asArray()->size() == 2000, "load large graph");
+
+	// Replace the file with a much smaller one while the slices are alive
+	check(serial::save(file, graph(3)), "save small graph over the loaded file");
+	check(!std::filesystem::exists(file + ".tmp"), "temporary file renamed");
+
+	bool same = true;
+	for (int i = 0; i < 2000; ++i)
+		same = same && (*files.asArray())[i].view() == path(i);
+	check(same, "old strings readable after save");
+
+	Value reloaded = serial::load(file);
+	check(reloaded.getField("files").asArray()->size() == 3, "reload sees the new graph");
+
+	// A failed save leaves the existing file untouched
+	check(!serial::save(file + ".missing/dir/out.phsv", graph(1)), "save into a missing directory fails");
+	check(serial::load(file).getField("files").asArray()->size() == 3, "file intact after failed save");
+
+	loaded   = Value();
+	files    = Value();
+	reloaded = Value();
+	std::filesystem::remove(file);
+
+	std::printf("%d checks\n", checks);
+	if (failures)
+	{
+		std::fprintf(stderr, "%d of %d checks failed\n", failures, checks);
+		return 1;
+	}
+	return 0;
+}
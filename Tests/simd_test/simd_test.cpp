@@ -0,0 +1,317 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <ArrayBuiltins.hpp>
+#include <Simd.hpp>
+#include <Value.hpp>
+
+// Checks every kernel in Simd.hpp against a plain loop at each dispatch level
+// the CPU supports, and the packed array builtins against the per-Value path.
+//
+// Lengths cover every tail shape of the 2-, 4-, 16- and 32-wide loops, and the
+// float inputs include NaN, infinities and -0.0.
+
+using namespace Phasor;
+
+namespace
+{
+
+int checks   = 0;
+int failures = 0;
+
+const char *levelName(simd::Level level)
+{
+	switch (level)
+	{
+	case simd::Level::Avx2:
+		return "avx2";
+	case simd::Level::Sse2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+void check(bool ok, const char *what, size_t n)
+{
+	++checks;
+	if (!ok && ++failures <= 20)
+		std::fprintf(stderr, "FAIL [%s] %s (n = %zu)\n", levelName(simd::activeLevel()), what, n);
+}
+
+// Bitwise equality, so -0.0 != 0.0 and NaN == NaN
+bool sameFloat(double a, double b)
+{
+	return std::memcmp(&a, &b, sizeof a) == 0 || (std::isnan(a) && std::isnan(b));
+}
+
+std::vector<size_t> lengths()
+{
+	std::vector<size_t> out;
+	for (size_t n = 0; n <= 70; ++n)
+		out.push_back(n);
+	for (size_t n : {127, 128, 129, 1000, 1001, 1003})
+		out.push_back(n);
+	return out;
+}
+
+std::mt19937_64 rng(12345);
+
+std::vector<int64_t> randomInts(size_t n)
+{
+	std::vector<int64_t> out(n);
+	for (auto &x : out)
+	{
+		switch (rng() % 8)
+		{
+		case 0:
+			x = std::numeric_limits<int64_t>::min();
+			break;
+		case 1:
+			x = std::numeric_limits<int64_t>::max();
+			break;
+		default:
+			x = static_cast<int64_t>(rng() % 2001) - 1000;
+		}
+	}
+	return out;
+}
+
+// Integral values keep float sums exact regardless of association order
+std::vector<double> randomFloats(size_t n, bool specials)
+{
+	std::vector<double> out(n);
+	for (auto &x : out)
+	{
+		switch (specials ? rng() % 10 : 9)
+		{
+		case 0:
+			x = std::numeric_limits<double>::quiet_NaN();
+			break;
+		case 1:
+			x = -0.0;
+			break;
+		case 2:
+			x = 0.0;
+			break;
+		default:
+			x = static_cast<double>(static_cast<int64_t>(rng() % 2001) - 1000);
+		}
+	}
+	return out;
+}
+
+void equality(size_t n)
+{
+	auto a = randomInts(n), b = a;
+	check(simd::equalInts(a.data(), b.data(), n), "equalInts same", n);
+	for (size_t i = 0; i < n; i += 1 + n / 40)
+	{
+		b[i] ^= 1;
+		check(!simd::equalInts(a.data(), b.data(), n), "equalInts differ", n);
+		b[i] ^= 1;
+	}
+
+	auto x = randomFloats(n, true), y = x;
+	bool expect = true;
+	for (size_t i = 0; i < n; ++i)
+		expect = expect && x[i] == y[i];
+	check(simd::equalFloats(x.data(), y.data(), n) == expect, "equalFloats", n);
+	for (auto &v : y)
+		if (v == 0.0)
+			v = -v;
+	check(simd::equalFloats(x.data(), y.data(), n) == expect, "equalFloats signed zero", n);
+}
+
+void sums(size_t n)
+{
+	auto     a   = randomInts(n);
+	uint64_t ref = 0;
+	for (auto v : a)
+		ref += static_cast<uint64_t>(v);
+	check(simd::sumInts(a.data(), n) == static_cast<int64_t>(ref), "sumInts", n);
+
+	auto   f    = randomFloats(n, false);
+	double fref = 0.0;
+	for (auto v : f)
+		fref += v;
+	check(simd::sumFloats(f.data(), n) == fref, "sumFloats", n);
+
+	std::vector<double> zeros(n, -0.0);
+	check(simd::sumFloats(zeros.data(), n) == 0.0, "sumFloats zeros", n);
+	if (n > 0)
+	{
+		f[n / 2] = std::numeric_limits<double>::infinity();
+		check(std::isinf(simd::sumFloats(f.data(), n)), "sumFloats inf", n);
+		f[n - 1] = std::numeric_limits<double>::quiet_NaN();
+		check(std::isnan(simd::sumFloats(f.data(), n)), "sumFloats NaN", n);
+	}
+}
+
+void extremes(size_t n)
+{
+	if (n == 0)
+		return;
+	auto a = randomInts(n);
+	check(simd::extremeInt(a.data(), n, true) == *std::max_element(a.begin(), a.end()), "extremeInt max", n);
+	check(simd::extremeInt(a.data(), n, false) == *std::min_element(a.begin(), a.end()), "extremeInt min", n);
+
+	// Without NaN the result is exact, with either zero sign accepted for 0
+	auto f = randomFloats(n, false);
+	f[rng() % n] = -0.0;
+	check(simd::extremeFloat(f.data(), n, true) == *std::max_element(f.begin(), f.end()), "extremeFloat max", n);
+	check(simd::extremeFloat(f.data(), n, false) == *std::min_element(f.begin(), f.end()), "extremeFloat min", n);
+
+	// With NaN the element is unspecified but must come from the input
+	auto g = randomFloats(n, true);
+	for (bool wantMax : {true, false})
+	{
+		double r     = simd::extremeFloat(g.data(), n, wantMax);
+		bool   found = false;
+		for (auto v : g)
+			found = found || sameFloat(v, r) || (v == 0.0 && r == 0.0);
+		check(found, "extremeFloat NaN picks an element", n);
+	}
+}
+
+void finds(size_t n)
+{
+	auto a = randomInts(n);
+	for (size_t i = 0; i < n; i += 1 + n / 40)
+	{
+		int64_t expect = std::find(a.begin(), a.end(), a[i]) - a.begin();
+		check(simd::findInt(a.data(), n, a[i]) == expect, "findInt present", n);
+	}
+	check(simd::findInt(a.data(), n, 5000) == -1, "findInt absent", n);
+
+	auto f = randomFloats(n, true);
+	for (size_t i = 0; i < n; i += 1 + n / 40)
+	{
+		int64_t expect = -1;
+		for (size_t j = 0; j < n && expect < 0; ++j)
+			if (f[j] == f[i])
+				expect = static_cast<int64_t>(j);
+		check(simd::findFloat(f.data(), n, f[i]) == expect, "findFloat present", n);
+	}
+	check(simd::findFloat(f.data(), n, std::numeric_limits<double>::quiet_NaN()) == -1, "findFloat NaN", n);
+}
+
+void applies(size_t n)
+{
+	auto a = randomInts(n), b = randomInts(n);
+	auto x = randomFloats(n, true), y = randomFloats(n, true);
+	for (simd::Op op : {simd::Op::Add, simd::Op::Sub, simd::Op::Mul})
+	{
+		std::vector<int64_t> out(n);
+		simd::applyInts(op, a.data(), b.data(), out.data(), n);
+		bool ok = true;
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto p = static_cast<uint64_t>(a[i]), q = static_cast<uint64_t>(b[i]);
+			ok = ok && out[i] == static_cast<int64_t>(op == simd::Op::Add ? p + q : op == simd::Op::Sub ? p - q : p * q);
+		}
+		check(ok, "applyInts", n);
+
+		std::vector<double> fout(n);
+		simd::applyFloats(op, x.data(), y.data(), fout.data(), n);
+		ok = true;
+		for (size_t i = 0; i < n; ++i)
+			ok = ok && sameFloat(fout[i], op == simd::Op::Add   ? x[i] + y[i]
+			                              : op == simd::Op::Sub ? x[i] - y[i]
+			                                                    : x[i] * y[i]);
+		check(ok, "applyFloats", n);
+	}
+}
+
+void escapes(size_t n)
+{
+	std::string clean(n, 'a');
+	for (size_t i = 0; i < n; ++i)
+		clean[i] = static_cast<char>('a' + rng() % 26);
+	check(simd::findEscape(clean.data(), n) == n, "findEscape clean", n);
+
+	const char specials[] = {'"', '\\', '\'', '\n', '\0', 0x1F, 0x7F, static_cast<char>(0x80), static_cast<char>(0xFF)};
+	for (char c : specials)
+	{
+		for (size_t i = 0; i < n; i += 1 + n / 40)
+		{
+			std::string s = clean;
+			s[i]          = c;
+			size_t expect = n;
+			for (size_t j = 0; j < n && expect == n; ++j)
+				if (simd::detail::needsEscape(s[j]))
+					expect = j;
+			check(simd::findEscape(s.data(), n) == expect, "findEscape", n);
+		}
+	}
+}
+
+// Packed builtins against the same elements in generic storage
+void arrayBuiltins(size_t n)
+{
+	auto ints   = randomInts(n);
+	auto floats = randomFloats(n, false);
+	for (auto &v : ints)
+		v %= 1000000;
+	Value packedInts(makeRef<Value::ArrayInstance>(ints));
+	Value packedFloats(makeRef<Value::ArrayInstance>(floats));
+	Value genericInts = Value::createArray(packedInts.asArray()->toVector());
+	genericInts.mutableArray().generic();
+	Value genericFloats = Value::createArray(packedFloats.asArray()->toVector());
+	genericFloats.mutableArray().generic();
+
+	check(builtins::array_sum(packedInts) == builtins::array_sum(genericInts), "array_sum int", n);
+	// An empty packed float array sums to 0.0, an empty generic one to 0
+	check(builtins::array_sum(packedFloats).asFloat() == builtins::array_sum(genericFloats).asFloat(),
+	      "array_sum float", n);
+	if (n > 0)
+	{
+		check(builtins::array_max(packedInts) == builtins::array_max(genericInts), "array_max", n);
+		check(builtins::array_min(packedFloats) == builtins::array_min(genericFloats), "array_min", n);
+		Value needle = (*packedInts.asArray())[n / 2];
+		check(builtins::array_find(packedInts, needle) == builtins::array_find(genericInts, needle), "array_find", n);
+	}
+	check(builtins::array_add(packedInts, packedInts) == builtins::array_add(genericInts, genericInts), "array_add", n);
+	check(builtins::array_mul(packedFloats, packedFloats) == builtins::array_mul(genericFloats, genericFloats),
+	      "array_mul", n);
+	check(packedInts == genericInts, "array equality", n);
+}
+
+} // namespace
+
+int main()
+{
+	for (auto level : {simd::Level::Scalar, simd::Level::Sse2, simd::Level::Avx2})
+	{
+		if (level > simd::supportedLevel())
+		{
+			std::printf("%-6s skipped (not supported by this CPU)\n", levelName(level));
+			continue;
+		}
+		simd::setLevel(level);
+		int before = checks;
+		for (size_t n : lengths())
+		{
+			equality(n);
+			sums(n);
+			extremes(n);
+			finds(n);
+			applies(n);
+			escapes(n);
+			arrayBuiltins(n);
+		}
+		std::printf("%-6s %d checks\n", levelName(level), checks - before);
+	}
+	if (failures)
+	{
+		std::fprintf(stderr, "%d of %d checks failed\n", failures, checks);
+		return 1;
+	}
+	return 0;
+}
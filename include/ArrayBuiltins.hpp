@@ -0,0 +1,295 @@
+#pragma once
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Simd.hpp"
+#include "Value.hpp"
+
+/**
+ * @brief Native array builtins
+ *
+ * Packed int and float arrays go through the vector kernels in Simd.hpp;
+ * generic arrays fall back to a per-Value loop with the usual operator
+ * semantics. Sorting compares packed and all-string arrays directly and
+ * splits large arrays across threads.
+ */
+namespace Phasor::builtins
+{
+
+/// @brief Sum of the elements, 0 for an empty array
+inline Value array_sum(const Value &array)
+{
+	const auto &arr = *array.asArray();
+	if (auto *v = arr.ints())
+		return Value(simd::sumInts(v->data(), v->size()));
+	if (auto *v = arr.floats())
+		return Value(simd::sumFloats(v->data(), v->size()));
+	Value sum(0);
+	for (size_t i = 0; i < arr.size(); ++i)
+		sum = sum + arr[i];
+	return sum;
+}
+
+namespace detail
+{
+inline Value array_extreme(const Value &array, bool wantMax)
+{
+	const auto &arr = *array.asArray();
+	if (arr.empty())
+		throw std::runtime_error(wantMax ? "array_max() of empty array" : "array_min() of empty array");
+	if (auto *v = arr.ints())
+		return Value(simd::extremeInt(v->data(), v->size(), wantMax));
+	if (auto *v = arr.floats())
+		return Value(simd::extremeFloat(v->data(), v->size(), wantMax));
+	Value best = arr[0];
+	for (size_t i = 1; i < arr.size(); ++i)
+	{
+		Value e = arr[i];
+		if (wantMax ? e > best : e < best)
+			best = std::move(e);
+	}
+	return best;
+}
+
+inline Value array_apply(simd::Op op, const Value &lhs, const Value &rhs)
+{
+	const auto &a = *lhs.asArray();
+	const auto &b = *rhs.asArray();
+	if (a.size() != b.size())
+		throw std::runtime_error("Element-wise operation on arrays of different length");
+	if (auto *x = a.ints(), *y = b.ints(); x && y)
+	{
+		Value::ArrayInstance::Ints out(x->size());
+		simd::applyInts(op, x->data(), y->data(), out.data(), out.size());
+		return Value(makeRef<Value::ArrayInstance>(std::move(out)));
+	}
+	if (auto *x = a.floats(), *y = b.floats(); x && y)
+	{
+		Value::ArrayInstance::Floats out(x->size());
+		simd::applyFloats(op, x->data(), y->data(), out.data(), out.size());
+		return Value(makeRef<Value::ArrayInstance>(std::move(out)));
+	}
+	std::vector<Value> out;
+	out.reserve(a.size());
+	for (size_t i = 0; i < a.size(); ++i)
+		out.push_back(op == simd::Op::Add ? a[i] + b[i] : op == simd::Op::Sub ? a[i] - b[i] : a[i] * b[i]);
+	return Value::createArray(std::move(out));
+}
+} // namespace detail
+
+/// @brief Smallest element
+inline Value array_min(const Value &array)
+{
+	return detail::array_extreme(array, false);
+}
+
+/// @brief Largest element
+inline Value array_max(const Value &array)
+{
+	return detail::array_extreme(array, true);
+}
+
+/// @brief Index of the first element equal to needle, or -1
+inline Value array_find(const Value &array, const Value &needle)
+{
+	const auto &arr = *array.asArray();
+	if (auto *v = arr.ints(); v && needle.isInt())
+		return Value(simd::findInt(v->data(), v->size(), needle.asInt()));
+	if (auto *v = arr.floats(); v && needle.isFloat())
+		return Value(simd::findFloat(v->data(), v->size(), needle.asFloat()));
+	for (size_t i = 0; i < arr.size(); ++i)
+		if (arr[i] == needle)
+			return Value(static_cast<int64_t>(i));
+	return Value(static_cast<int64_t>(-1));
+}
+
+/// @brief Element-wise equality
+inline Value array_equal(const Value &lhs, const Value &rhs)
+{
+	return Value(lhs == rhs);
+}
+
+/// @brief Element-wise sum of two arrays of equal length
+inline Value array_add(const Value &lhs, const Value &rhs)
+{
+	return detail::array_apply(simd::Op::Add, lhs, rhs);
+}
+
+/// @brief Element-wise difference of two arrays of equal length
+inline Value array_sub(const Value &lhs, const Value &rhs)
+{
+	return detail::array_apply(simd::Op::Sub, lhs, rhs);
+}
+
+/// @brief Element-wise product of two arrays of equal length
+inline Value array_mul(const Value &lhs, const Value &rhs)
+{
+	return detail::array_apply(simd::Op::Mul, lhs, rhs);
+}
+
+namespace detail
+{
+/// @brief Arrays shorter than this are sorted on the calling thread
+inline constexpr size_t ParallelSortThreshold = 1 << 16;
+
+/// @brief Run f(0) .. f(count - 1) concurrently, rethrowing the first failure
+template <typename F> void runParallel(size_t count, F &&f)
+{
+	std::vector<std::exception_ptr> errors(count);
+	auto run = [&](size_t i) {
+		try
+		{
+			f(i);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+		}
+	};
+	std::vector<std::thread> workers;
+	workers.reserve(count - 1);
+	for (size_t i = 1; i < count; ++i)
+		workers.emplace_back(run, i);
+	run(0);
+	for (auto &w : workers)
+		w.join();
+	for (auto &e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
+
+/// @brief Sort [first, last), splitting large ranges into sorted runs merged pairwise
+///
+/// Elements are only moved and compared, never copied, so Values can be
+/// sorted across threads without touching their reference counts.
+template <typename It, typename Cmp> void parallelSort(It first, It last, Cmp cmp, bool stable)
+{
+	auto sortRange = [&](It lo, It hi) {
+		if (stable)
+			std::stable_sort(lo, hi, cmp);
+		else
+			std::sort(lo, hi, cmp);
+	};
+	size_t n       = static_cast<size_t>(last - first);
+	size_t threads = std::min<size_t>(std::thread::hardware_concurrency(), n / (ParallelSortThreshold / 4));
+	size_t parts   = 1;
+	while (parts * 2 <= std::min<size_t>(threads, 8))
+		parts *= 2;
+	if (n < ParallelSortThreshold || parts < 2)
+	{
+		sortRange(first, last);
+		return;
+	}
+
+	std::vector<It> bounds(parts + 1);
+	for (size_t i = 0; i <= parts; ++i)
+		bounds[i] = first + static_cast<std::ptrdiff_t>(n * i / parts);
+	runParallel(parts, [&](size_t i) { sortRange(bounds[i], bounds[i + 1]); });
+	// inplace_merge keeps the left run first on ties, so stability survives
+	for (size_t width = 1; width < parts; width *= 2)
+		runParallel(parts / (2 * width), [&](size_t k) {
+			size_t i = 2 * k * width;
+			std::inplace_merge(bounds[i], bounds[i + width], bounds[i + 2 * width], cmp);
+		});
+}
+
+/// @brief Float ordering with NaNs after every number
+inline bool floatLess(double a, double b)
+{
+	return a < b || (b != b && a == a);
+}
+
+inline void array_sort(Value &array, bool stable)
+{
+	auto &arr = array.mutableArray();
+	if (arr.size() < 2)
+		return;
+	if (auto *v = arr.ints())
+		return parallelSort(v->begin(), v->end(), std::less<int64_t>(), stable);
+	if (auto *v = arr.floats())
+		return parallelSort(v->begin(), v->end(), floatLess, stable);
+	if (arr.bools())
+		throw std::runtime_error("Cannot compare these value types ");
+	auto &v = arr.generic();
+	if (std::all_of(v.begin(), v.end(), [](const Value &e) { return e.isString(); }))
+		return parallelSort(
+		    v.begin(), v.end(), [](const Value &a, const Value &b) { return a.view() < b.view(); }, stable);
+	parallelSort(v.begin(), v.end(), std::less<Value>(), stable);
+}
+
+/// @brief Index of the first element not less than needle
+inline size_t lowerBound(const Value::ArrayInstance &arr, const Value &needle)
+{
+	if (auto *v = arr.ints(); v && needle.isInt())
+		return std::lower_bound(v->begin(), v->end(), needle.asInt()) - v->begin();
+	if (auto *v = arr.floats(); v && needle.isNumber())
+		return std::lower_bound(v->begin(), v->end(), needle.asFloat(), floatLess) - v->begin();
+	size_t lo = 0, hi = arr.size();
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (arr[mid] < needle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+} // namespace detail
+
+/// @brief Sort the array ascending in place and return it
+inline Value array_sort(Value &array)
+{
+	detail::array_sort(array, false);
+	return array;
+}
+
+/// @brief Sort the array ascending in place, keeping equal elements in order, and return it
+inline Value array_stable_sort(Value &array)
+{
+	detail::array_sort(array, true);
+	return array;
+}
+
+/// @brief Index where needle would be inserted to keep a sorted array sorted
+inline Value array_lower_bound(const Value &array, const Value &needle)
+{
+	return Value(static_cast<int64_t>(detail::lowerBound(*array.asArray(), needle)));
+}
+
+/// @brief Index of an element equal to needle in a sorted array, or -1
+inline Value array_search(const Value &array, const Value &needle)
+{
+	const auto &arr = *array.asArray();
+	size_t i        = detail::lowerBound(arr, needle);
+	if (i < arr.size() && !(needle < arr[i]))
+		return Value(static_cast<int64_t>(i));
+	return Value(static_cast<int64_t>(-1));
+}
+
+/// @brief Move the elements less than pivot to the front and return how many there are
+inline Value array_partition(Value &array, const Value &pivot)
+{
+	auto &arr = array.mutableArray();
+	if (auto *v = arr.ints(); v && pivot.isNumber())
+	{
+		auto less = [&pivot](int64_t e) { return pivot.isInt() ? e < pivot.asInt() : e < pivot.asFloat(); };
+		return Value(static_cast<int64_t>(std::partition(v->begin(), v->end(), less) - v->begin()));
+	}
+	if (auto *v = arr.floats(); v && pivot.isNumber())
+	{
+		double p = pivot.asFloat();
+		return Value(static_cast<int64_t>(
+		    std::partition(v->begin(), v->end(), [p](double e) { return detail::floatLess(e, p); }) - v->begin()));
+	}
+	if (arr.empty())
+		return Value(static_cast<int64_t>(0));
+	auto &v = arr.generic();
+	return Value(static_cast<int64_t>(
+	    std::partition(v.begin(), v.end(), [&pivot](const Value &e) { return e < pivot; }) - v.begin()));
+}
+
+} // namespace Phasor::builtins
@@ -0,0 +1,290 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace Phasor
+{
+
+/**
+ * @brief Size-class pool allocator for VM heap objects and their payloads
+ *
+ * Small blocks are carved out of large chunks and recycled through one free
+ * list per 16-byte size class; larger requests go straight to the global
+ * allocator. Chunks are only returned to the system by release() or when the
+ * heap is destroyed, so a VM can drop everything at shutdown in one pass
+ * instead of freeing each object. reset() rewinds the heap but keeps its
+ * chunks, so a host running one script after another reuses the same memory.
+ *
+ * Chunks are aligned to their size and start with a pointer to the owning
+ * heap, and large blocks carry the same pointer in a header, so owner() can
+ * find the heap a block came from. Objects are returned there even when a
+ * different heap is current; the owning heap must outlive them.
+ *
+ * The VM is single-threaded and so is the heap.
+ */
+class Heap
+{
+  public:
+	static constexpr size_t Granularity = 16;
+	static constexpr size_t ClassCount  = 16;
+	static constexpr size_t MaxSmall    = Granularity * ClassCount;
+	static constexpr size_t ChunkSize   = 64 * 1024;
+
+	/// @brief Allocation counters
+	struct Stats
+	{
+		uint64_t allocations      = 0;
+		uint64_t deallocations    = 0;
+		uint64_t largeAllocations = 0;
+		uint64_t bytesInUse       = 0;
+		uint64_t peakBytesInUse   = 0;
+		uint64_t chunkBytes       = 0;
+	};
+
+	Heap() = default;
+	Heap(const Heap &)            = delete;
+	Heap &operator=(const Heap &) = delete;
+	~Heap()
+	{
+		release();
+	}
+
+	/// @brief Allocate a block of at least `size` bytes
+	void *allocate(size_t size)
+	{
+		++counters.allocations;
+		counters.bytesInUse += size;
+		if (counters.bytesInUse > counters.peakBytesInUse)
+			counters.peakBytesInUse = counters.bytesInUse;
+
+		if (size == 0 || size > MaxSmall)
+		{
+			++counters.largeAllocations;
+			auto *block                       = static_cast<char *>(::operator new(size + HeaderSize));
+			*reinterpret_cast<Heap **>(block) = this;
+			return block + HeaderSize;
+		}
+
+		size_t cls = (size - 1) / Granularity;
+		if (FreeBlock *block = freeLists[cls])
+		{
+			freeLists[cls] = block->next;
+			return block;
+		}
+
+		size_t blockSize = (cls + 1) * Granularity;
+		if (static_cast<size_t>(chunkEnd - cursor) < blockSize)
+			newChunk();
+		void *block = cursor;
+		cursor += blockSize;
+		return block;
+	}
+
+	/// @brief Return a block obtained from allocate() with the same size
+	void deallocate(void *p, size_t size)
+	{
+		if (!p)
+			return;
+		++counters.deallocations;
+		counters.bytesInUse -= size;
+
+		if (size == 0 || size > MaxSmall)
+		{
+			::operator delete(static_cast<char *>(p) - HeaderSize);
+			return;
+		}
+
+		size_t cls     = (size - 1) / Granularity;
+		auto  *block   = static_cast<FreeBlock *>(p);
+		block->next    = freeLists[cls];
+		freeLists[cls] = block;
+	}
+
+	/// @brief Free every chunk at once. No block may still be in use.
+	void release()
+	{
+		for (void *chunk : chunks)
+			::operator delete(chunk, std::align_val_t(ChunkSize));
+		chunks.clear();
+		counters.chunkBytes = 0;
+		reset();
+	}
+
+	/// @brief Forget every block but keep the chunks for reuse. No block may still be in use.
+	void reset()
+	{
+		assert(liveBlocks() == 0 && "Heap rewound while objects are still alive");
+		freeLists.fill(nullptr);
+		nextChunk                 = 0;
+		cursor                    = nullptr;
+		chunkEnd                  = nullptr;
+		counters.allocations      = 0;
+		counters.deallocations    = 0;
+		counters.largeAllocations = 0;
+		counters.bytesInUse       = 0;
+	}
+
+	/// @brief Number of blocks allocated and not yet freed
+	uint64_t liveBlocks() const
+	{
+		return counters.allocations - counters.deallocations;
+	}
+
+	/// @brief Get the heap that allocated a block of `size` bytes
+	static Heap &owner(const void *p, size_t size)
+	{
+		auto addr = reinterpret_cast<uintptr_t>(p);
+		if (size == 0 || size > MaxSmall)
+			addr -= HeaderSize;
+		else
+			addr &= ~static_cast<uintptr_t>(ChunkSize - 1);
+		return **reinterpret_cast<Heap *const *>(addr);
+	}
+
+	/// @brief Get the allocation counters
+	const Stats &stats() const
+	{
+		return counters;
+	}
+
+	/// @brief Get the heap new VM objects are allocated from
+	static Heap &current()
+	{
+		return *currentSlot();
+	}
+
+	/// @brief Make `heap` current, returning the previously current heap
+	static Heap *setCurrent(Heap *heap)
+	{
+		Heap *previous = currentSlot();
+		currentSlot()  = heap;
+		return previous;
+	}
+
+	/// @brief Makes a heap current for the lifetime of the scope
+	class Scope
+	{
+	  public:
+		explicit Scope(Heap &heap) : previous(setCurrent(&heap))
+		{
+		}
+		~Scope()
+		{
+			setCurrent(previous);
+		}
+		Scope(const Scope &)            = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	  private:
+		Heap *previous;
+	};
+
+  private:
+	// Room for the owner pointer, keeping blocks Granularity-aligned
+	static constexpr size_t HeaderSize = Granularity;
+
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+
+	void newChunk()
+	{
+		if (nextChunk == chunks.size())
+		{
+			void *chunk                  = ::operator new(ChunkSize, std::align_val_t(ChunkSize));
+			*static_cast<Heap **>(chunk) = this;
+			chunks.push_back(chunk);
+			counters.chunkBytes += ChunkSize;
+		}
+		auto *chunk = static_cast<char *>(chunks[nextChunk++]);
+		cursor      = chunk + HeaderSize;
+		chunkEnd    = chunk + ChunkSize;
+	}
+
+	// The default heap is deliberately leaked: the process exit reclaims it,
+	// and Values in static storage can still be freed after main returns.
+	static Heap *&currentSlot()
+	{
+		static Heap *heap = new Heap;
+		return heap;
+	}
+
+	std::array<FreeBlock *, ClassCount> freeLists{};
+	std::vector<void *>                 chunks;
+	size_t                              nextChunk = 0;
+	char                               *cursor   = nullptr;
+	char                               *chunkEnd = nullptr;
+	Stats                               counters;
+};
+
+/**
+ * @brief Base that allocates a class from the current Heap and frees it to its owner
+ *
+ * With PHASOR_ATOMIC_REFCOUNT objects may be freed from any thread, so the
+ * pool is bypassed in favour of the global allocator.
+ */
+struct HeapObject
+{
+#ifndef PHASOR_ATOMIC_REFCOUNT
+	static void *operator new(size_t size)
+	{
+		return Heap::current().allocate(size);
+	}
+	static void operator delete(void *p, size_t size)
+	{
+		Heap::owner(p, size).deallocate(p, size);
+	}
+#endif
+};
+
+/**
+ * @brief Standard allocator over the current Heap, for the payloads of heap objects
+ *
+ * Like HeapObject, blocks come from the current heap and go back to their
+ * owner, so every instance compares equal. With PHASOR_ATOMIC_REFCOUNT the
+ * global allocator is used instead.
+ */
+template <typename T> struct HeapAllocator
+{
+	using value_type      = T;
+	using is_always_equal = std::true_type;
+
+	HeapAllocator() = default;
+	template <typename U> HeapAllocator(const HeapAllocator<U> &)
+	{
+	}
+
+	T *allocate(size_t n)
+	{
+		static_assert(alignof(T) <= Heap::Granularity, "Heap blocks are only Granularity-aligned");
+#ifdef PHASOR_ATOMIC_REFCOUNT
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+#else
+		return static_cast<T *>(Heap::current().allocate(n * sizeof(T)));
+#endif
+	}
+	void deallocate(T *p, size_t n)
+	{
+#ifdef PHASOR_ATOMIC_REFCOUNT
+		::operator delete(p);
+#else
+		Heap::owner(p, n * sizeof(T)).deallocate(p, n * sizeof(T));
+#endif
+	}
+
+	template <typename U> bool operator==(const HeapAllocator<U> &) const
+	{
+		return true;
+	}
+};
+
+/// @brief A vector whose elements live in the Heap
+template <typename T> using HeapVector = std::vector<T, HeapAllocator<T>>;
+
+} // namespace Phasor
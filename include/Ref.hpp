@@ -0,0 +1,174 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#ifdef PHASOR_ATOMIC_REFCOUNT
+#include <atomic>
+#endif
+
+namespace Phasor
+{
+
+/**
+ * @brief Base for VM heap objects owned through Ref
+ *
+ * The count lives in the object itself, so handles need no separate control
+ * block. The VM is single-threaded and counts with a plain integer; define
+ * PHASOR_ATOMIC_REFCOUNT to make the count atomic when Values cross threads.
+ */
+class RefCounted
+{
+  public:
+	/// @brief Take a reference
+	void retain() const
+	{
+#ifdef PHASOR_ATOMIC_REFCOUNT
+		refs.fetch_add(1, std::memory_order_relaxed);
+#else
+		++refs;
+#endif
+	}
+
+	/// @brief Drop a reference, returning true when it was the last one
+	bool release() const
+	{
+#ifdef PHASOR_ATOMIC_REFCOUNT
+		return refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+		return --refs == 0;
+#endif
+	}
+
+	/// @brief Get the current number of references
+	uint32_t refCount() const
+	{
+#ifdef PHASOR_ATOMIC_REFCOUNT
+		return refs.load(std::memory_order_acquire);
+#else
+		return refs;
+#endif
+	}
+
+  protected:
+	RefCounted() = default;
+	// A copied object starts with no owners of its own
+	RefCounted(const RefCounted &)
+	{
+	}
+	RefCounted &operator=(const RefCounted &)
+	{
+		return *this;
+	}
+	~RefCounted() = default;
+
+  private:
+#ifdef PHASOR_ATOMIC_REFCOUNT
+	mutable std::atomic<uint32_t> refs{0};
+#else
+	mutable uint32_t refs = 0;
+#endif
+};
+
+/**
+ * @brief Owning handle to a RefCounted object
+ *
+ * Behaves like std::shared_ptr for the operations the VM uses.
+ */
+template <typename T> class Ref
+{
+  public:
+	Ref() = default;
+	Ref(std::nullptr_t)
+	{
+	}
+	/// @brief Adopt a raw pointer, taking a reference
+	explicit Ref(T *p) : ptr(p)
+	{
+		if (ptr)
+			ptr->retain();
+	}
+	Ref(const Ref &other) : Ref(other.ptr)
+	{
+	}
+	Ref(Ref &&other) noexcept : ptr(std::exchange(other.ptr, nullptr))
+	{
+	}
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+	Ref(const Ref<U> &other) : Ref(other.ptr)
+	{
+	}
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+	Ref(Ref<U> &&other) noexcept : ptr(std::exchange(other.ptr, nullptr))
+	{
+	}
+	~Ref()
+	{
+		reset();
+	}
+
+	Ref &operator=(const Ref &other)
+	{
+		Ref(other).swap(*this);
+		return *this;
+	}
+	Ref &operator=(Ref &&other) noexcept
+	{
+		Ref(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	/// @brief Drop the held reference
+	void reset()
+	{
+		if (ptr && ptr->release())
+			delete ptr;
+		ptr = nullptr;
+	}
+
+	void swap(Ref &other) noexcept
+	{
+		std::swap(ptr, other.ptr);
+	}
+
+	T *get() const
+	{
+		return ptr;
+	}
+	T &operator*() const
+	{
+		return *ptr;
+	}
+	T *operator->() const
+	{
+		return ptr;
+	}
+	explicit operator bool() const
+	{
+		return ptr != nullptr;
+	}
+
+	/// @brief Get the number of handles sharing the object
+	uint32_t useCount() const
+	{
+		return ptr ? ptr->refCount() : 0;
+	}
+
+	friend bool operator==(const Ref &a, const Ref &b)
+	{
+		return a.ptr == b.ptr;
+	}
+
+  private:
+	template <typename> friend class Ref;
+
+	T *ptr = nullptr;
+};
+
+/// @brief Allocate a RefCounted object and return its first handle
+template <typename T, typename... Args> Ref<T> makeRef(Args &&...args)
+{
+	return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+} // namespace Phasor
@@ -0,0 +1,545 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Value.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Binary serialization of Value graphs
+ *
+ * Layout (all integers little-endian):
+ *
+ *     "PHSV" u16 version u16 flags  root-node
+ *
+ * Each node starts with a one-byte Tag. Arrays, structs and maps are
+ * numbered in the order they are first written; a later reference to the
+ * same object, including a cycle, is written as a Ref tag with that number,
+ * so shared subgraphs load back shared.
+ *
+ * load() maps the file and decodes strings of Value::SliceThreshold bytes or
+ * more as slices of the mapping, which stays mapped while any of them is
+ * alive.
+ */
+namespace Phasor::serial
+{
+
+inline constexpr char     Magic[4] = {'P', 'H', 'S', 'V'};
+inline constexpr uint16_t Version  = 1;
+
+enum class Tag : uint8_t
+{
+	Null,
+	False,
+	True,
+	Int,
+	Float,
+	String,
+	Array,       ///< u8 flags, u64 count, nodes
+	IntArray,    ///< u8 flags, u64 count, i64 elements
+	FloatArray,  ///< u8 flags, u64 count, f64 elements
+	Struct,      ///< string name, u64 count, (string name, node) pairs
+	Ref,         ///< u64 object number
+	Map          ///< u64 count, (key node, value node) pairs
+};
+
+/// @brief Array flag: the array is copy-on-write
+inline constexpr uint8_t CopyOnWriteFlag = 1;
+
+namespace detail
+{
+class Writer
+{
+  public:
+	std::string out;
+
+	void u8(uint8_t v)
+	{
+		out.push_back(static_cast<char>(v));
+	}
+	void u16(uint16_t v)
+	{
+		for (int i = 0; i < 2; ++i)
+			u8(static_cast<uint8_t>(v >> (8 * i)));
+	}
+	void u64(uint64_t v)
+	{
+		for (int i = 0; i < 8; ++i)
+			u8(static_cast<uint8_t>(v >> (8 * i)));
+	}
+	void str(std::string_view s)
+	{
+		u64(s.size());
+		out.append(s);
+	}
+
+	void node(const Value &v)
+	{
+		switch (v.getType())
+		{
+		case ValueType::Null:
+			u8(static_cast<uint8_t>(Tag::Null));
+			break;
+		case ValueType::Bool:
+			u8(static_cast<uint8_t>(v.asBool() ? Tag::True : Tag::False));
+			break;
+		case ValueType::Int:
+			u8(static_cast<uint8_t>(Tag::Int));
+			u64(static_cast<uint64_t>(v.asInt()));
+			break;
+		case ValueType::Float:
+			u8(static_cast<uint8_t>(Tag::Float));
+			u64(std::bit_cast<uint64_t>(v.asFloat()));
+			break;
+		case ValueType::String:
+			u8(static_cast<uint8_t>(Tag::String));
+			str(v.view());
+			break;
+		case ValueType::Array:
+		{
+			const auto &arr = *v.asArray();
+			if (backref(&arr))
+				break;
+			uint8_t flags = arr.copyOnWrite ? CopyOnWriteFlag : 0;
+			if (auto *ints = arr.ints())
+			{
+				u8(static_cast<uint8_t>(Tag::IntArray));
+				u8(flags);
+				u64(ints->size());
+				for (int64_t e : *ints)
+					u64(static_cast<uint64_t>(e));
+			}
+			else if (auto *floats = arr.floats())
+			{
+				u8(static_cast<uint8_t>(Tag::FloatArray));
+				u8(flags);
+				u64(floats->size());
+				for (double e : *floats)
+					u64(std::bit_cast<uint64_t>(e));
+			}
+			else
+			{
+				u8(static_cast<uint8_t>(Tag::Array));
+				u8(flags);
+				u64(arr.size());
+				arr.forEach([&](const Value &e) { node(e); });
+			}
+			break;
+		}
+		case ValueType::Struct:
+		{
+			const auto &s = *v.asStruct();
+			if (backref(&s))
+				break;
+			u8(static_cast<uint8_t>(Tag::Struct));
+			str(s.structName());
+			const auto &names = s.shape->fieldNames();
+			u64(names.size());
+			for (size_t i = 0; i < names.size(); ++i)
+			{
+				str(names[i]);
+				node(s.slots[i]);
+			}
+			break;
+		}
+		case ValueType::Map:
+		{
+			const auto &m = *v.asMap();
+			if (backref(&m))
+				break;
+			u8(static_cast<uint8_t>(Tag::Map));
+			u64(m.size());
+			m.forEach([&](const Value &key, const Value &value) {
+				node(key);
+				node(value);
+			});
+			break;
+		}
+		}
+	}
+
+  private:
+	// Write a Ref if the object was already written, else number it
+	bool backref(const void *object)
+	{
+		auto [it, inserted] = numbers.emplace(object, numbers.size());
+		if (inserted)
+			return false;
+		u8(static_cast<uint8_t>(Tag::Ref));
+		u64(it->second);
+		return true;
+	}
+
+	std::unordered_map<const void *, uint64_t> numbers;
+};
+
+class Reader
+{
+  public:
+	/// @brief Deepest nesting of arrays, structs and maps accepted, bounding recursion
+	static constexpr size_t MaxDepth = 512;
+
+	Reader(std::string_view bytes, std::shared_ptr<const void> owner) : bytes(bytes), owner(std::move(owner))
+	{
+	}
+
+	Value document()
+	{
+		if (bytes.size() < 8 || std::memcmp(bytes.data(), Magic, sizeof(Magic)) != 0)
+			throw std::runtime_error("Not a serialized Phasor value");
+		pos = sizeof(Magic);
+		if (u16() != Version)
+			throw std::runtime_error("Unsupported serialized value version");
+		u16(); // flags, none defined yet
+		return node();
+	}
+
+  private:
+	void need(uint64_t n) const
+	{
+		if (n > bytes.size() - pos)
+			throw std::runtime_error("Truncated serialized value");
+	}
+	uint8_t u8()
+	{
+		need(1);
+		return static_cast<uint8_t>(bytes[pos++]);
+	}
+	uint16_t u16()
+	{
+		need(2);
+		uint16_t v = 0;
+		for (int i = 0; i < 2; ++i)
+			v |= static_cast<uint16_t>(static_cast<uint8_t>(bytes[pos++]) << (8 * i));
+		return v;
+	}
+	uint64_t u64()
+	{
+		need(8);
+		uint64_t v = 0;
+		for (int i = 0; i < 8; ++i)
+			v |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[pos++])) << (8 * i);
+		return v;
+	}
+	std::string_view raw()
+	{
+		uint64_t len = u64();
+		need(len);
+		std::string_view s = bytes.substr(pos, len);
+		pos += len;
+		return s;
+	}
+	uint64_t count(uint64_t minElementSize)
+	{
+		uint64_t n = u64();
+		if (n > (bytes.size() - pos) / minElementSize)
+			throw std::runtime_error("Truncated serialized value");
+		return n;
+	}
+
+	Value string()
+	{
+		size_t           at = pos + 8;
+		std::string_view s  = raw();
+		if (!owner || s.size() < Value::SliceThreshold)
+			return Value(std::string(s));
+		if (!buffer)
+			buffer = makeRef<Value::StringInstance>(bytes, owner);
+		return Value::createSlice(buffer, at, s.size());
+	}
+
+	Value node()
+	{
+		switch (static_cast<Tag>(u8()))
+		{
+		case Tag::Null:
+			return Value();
+		case Tag::False:
+			return Value(false);
+		case Tag::True:
+			return Value(true);
+		case Tag::Int:
+			return Value(static_cast<int64_t>(u64()));
+		case Tag::Float:
+			return Value(std::bit_cast<double>(u64()));
+		case Tag::String:
+			return string();
+		case Tag::IntArray:
+		case Tag::FloatArray:
+		{
+			bool     isInt = static_cast<Tag>(bytes[pos - 1]) == Tag::IntArray;
+			uint8_t  flags = u8();
+			uint64_t n     = count(8);
+			Ref<Value::ArrayInstance> arr;
+			if (isInt)
+			{
+				Value::ArrayInstance::Ints elements(n);
+				for (auto &e : elements)
+					e = static_cast<int64_t>(u64());
+				arr = makeRef<Value::ArrayInstance>(std::move(elements));
+			}
+			else
+			{
+				Value::ArrayInstance::Floats elements(n);
+				for (auto &e : elements)
+					e = std::bit_cast<double>(u64());
+				arr = makeRef<Value::ArrayInstance>(std::move(elements));
+			}
+			arr->copyOnWrite = flags & CopyOnWriteFlag;
+			objects.push_back(Value(arr));
+			return objects.back();
+		}
+		case Tag::Array:
+		{
+			uint8_t  flags = u8();
+			uint64_t n     = count(1);
+			// Register before decoding elements so cycles resolve. The elements
+			// are added to the instance directly, since the registered Value
+			// shares it and a copy-on-write detach would split the two
+			auto arr         = makeRef<Value::ArrayInstance>();
+			arr->copyOnWrite = flags & CopyOnWriteFlag;
+			objects.push_back(Value(arr));
+			arr->reserve(n);
+			for (uint64_t i = 0; i < n; ++i)
+				arr->push_back(child());
+			return Value(arr);
+		}
+		case Tag::Struct:
+		{
+			Value s = Value::createStruct(std::string(raw()));
+			objects.push_back(s);
+			uint64_t n = count(9);
+			for (uint64_t i = 0; i < n; ++i)
+			{
+				std::string name(raw());
+				s.setField(name, child());
+			}
+			return s;
+		}
+		case Tag::Map:
+		{
+			// Register before decoding entries so cycles resolve
+			Value map = Value::createMap();
+			objects.push_back(map);
+			uint64_t n = count(2);
+			auto    &m = *map.asMap();
+			for (uint64_t i = 0; i < n; ++i)
+			{
+				Value key = child();
+				m.set(key, child());
+			}
+			return map;
+		}
+		case Tag::Ref:
+		{
+			uint64_t id = u64();
+			if (id >= objects.size())
+				throw std::runtime_error("Serialized value references an unknown object");
+			return objects[id];
+		}
+		}
+		throw std::runtime_error("Unknown tag in serialized value");
+	}
+
+	// Decode a nested node; a failed decode abandons the reader, so the
+	// depth is not restored on throw
+	Value child()
+	{
+		if (depth == MaxDepth)
+			throw std::runtime_error("Serialized value is nested too deeply");
+		++depth;
+		Value v = node();
+		--depth;
+		return v;
+	}
+
+	std::string_view            bytes;
+	size_t                      pos   = 0;
+	size_t                      depth = 0;
+	std::shared_ptr<const void> owner;
+	Ref<Value::StringInstance>  buffer;
+	std::vector<Value>          objects;
+};
+
+#ifdef _WIN32
+// Owns a Win32 handle and closes it on destruction
+class Handle
+{
+  public:
+	explicit Handle(HANDLE handle) : handle(handle == INVALID_HANDLE_VALUE ? nullptr : handle)
+	{
+	}
+	~Handle()
+	{
+		if (handle)
+			CloseHandle(handle);
+	}
+
+	Handle(const Handle &)            = delete;
+	Handle &operator=(const Handle &) = delete;
+
+	HANDLE get() const
+	{
+		return handle;
+	}
+	explicit operator bool() const
+	{
+		return handle != nullptr;
+	}
+
+  private:
+	HANDLE handle;
+};
+#endif
+
+// Read-only mapping of a whole file
+class MappedFile
+{
+  public:
+	explicit MappedFile(const std::string &path)
+	{
+#ifdef _WIN32
+		// The view keeps the mapping alive, so both handles close on return
+		// FILE_SHARE_DELETE lets save() replace the file while it is mapped
+		Handle file(CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+		if (!file)
+			throw std::runtime_error("Failed to open " + path);
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file.get(), &size))
+			throw std::runtime_error("Failed to stat " + path);
+		length = static_cast<size_t>(size.QuadPart);
+		if (length)
+		{
+			Handle mapping(CreateFileMappingA(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+			if (!mapping || !(address = MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0)))
+				throw std::runtime_error("Failed to map " + path);
+		}
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("Failed to open " + path);
+		struct stat st;
+		if (::fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			throw std::runtime_error("Failed to stat " + path);
+		}
+		length = static_cast<size_t>(st.st_size);
+		if (length)
+		{
+			address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address == MAP_FAILED)
+				address = nullptr;
+		}
+		::close(fd);
+		if (length && !address)
+			throw std::runtime_error("Failed to map " + path);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (address)
+			UnmapViewOfFile(address);
+#else
+		if (address)
+			::munmap(address, length);
+#endif
+	}
+
+	MappedFile(const MappedFile &)            = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	std::string_view contents() const
+	{
+		return std::string_view(static_cast<const char *>(address), length);
+	}
+
+  private:
+	void  *address = nullptr;
+	size_t length  = 0;
+};
+} // namespace detail
+
+/// @brief Serialize a Value graph
+inline std::string encode(const Value &root)
+{
+	detail::Writer w;
+	w.out.append(Magic, sizeof(Magic));
+	w.u16(Version);
+	w.u16(0);
+	w.node(root);
+	return std::move(w.out);
+}
+
+/// @brief Deserialize a Value graph, copying every string
+inline Value decode(std::string_view bytes)
+{
+	return detail::Reader(bytes, nullptr).document();
+}
+
+/// @brief Deserialize a Value graph whose long strings slice into `bytes`
+///
+/// `owner` must keep `bytes` alive; the decoded strings hold on to it.
+inline Value decode(std::string_view bytes, std::shared_ptr<const void> owner)
+{
+	return detail::Reader(bytes, std::move(owner)).document();
+}
+
+/// @brief Write a serialized Value graph to a file
+///
+/// The graph is written to `path + ".tmp"` and renamed over `path`, so a
+/// failed write leaves the old file intact and strings still sliced from a
+/// load() of the same path keep their mapping.
+inline bool save(const std::string &path, const Value &root)
+{
+	std::string data = encode(root);
+	std::string temp = path + ".tmp";
+	FILE       *f    = std::fopen(temp.c_str(), "wb");
+	if (!f)
+		return false;
+	bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+	ok      = std::fflush(f) == 0 && ok;
+	ok      = std::fclose(f) == 0 && ok;
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+	if (!ok)
+		std::remove(temp.c_str());
+	return ok;
+}
+
+/// @brief Load a serialized Value graph from a memory-mapped file
+inline Value load(const std::string &path)
+{
+	auto file = std::make_shared<detail::MappedFile>(path);
+	return decode(file->contents(), file);
+}
+
+} // namespace Phasor::serial
@@ -0,0 +1,595 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PHASOR_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PHASOR_TARGET_AVX2
+#else
+#define PHASOR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/**
+ * @brief Vector kernels over packed array storage
+ *
+ * Each kernel has a scalar version, an SSE2 version (always available on
+ * x86-64) and an AVX2 version selected at runtime; setLevel() can force a
+ * narrower one. Floating point sums are
+ * reassociated across lanes, and min/max of arrays containing NaN pick an
+ * unspecified element.
+ */
+namespace Phasor::simd
+{
+
+/// @brief Check once whether the CPU and OS support AVX2
+inline bool hasAvx2()
+{
+#ifdef PHASOR_SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+	static const bool avx2 = [] {
+		int r[4];
+		__cpuid(r, 0);
+		if (r[0] < 7)
+			return false;
+		__cpuid(r, 1);
+		bool osxsave = (r[2] & (1 << 27)) != 0;
+		bool avx     = (r[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(r, 7, 0);
+		return (r[1] & (1 << 5)) != 0;
+	}();
+#else
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+/// @brief Instruction sets the kernels can dispatch to, in increasing order
+enum class Level
+{
+	Scalar,
+	Sse2,
+	Avx2
+};
+
+/// @brief Get the best level this CPU supports
+inline Level supportedLevel()
+{
+#ifdef PHASOR_SIMD_X86
+	return hasAvx2() ? Level::Avx2 : Level::Sse2;
+#else
+	return Level::Scalar;
+#endif
+}
+
+namespace detail
+{
+inline Level &levelSlot()
+{
+	static Level level = supportedLevel();
+	return level;
+}
+} // namespace detail
+
+/// @brief Get the level the kernels currently dispatch to
+inline Level activeLevel()
+{
+	return detail::levelSlot();
+}
+
+/// @brief Cap dispatch at `level`, returning the previous level
+///
+/// Lets tests and benchmarks run the narrower paths on a wider CPU; a level
+/// above supportedLevel() is clamped to it.
+inline Level setLevel(Level level)
+{
+	Level previous      = detail::levelSlot();
+	detail::levelSlot() = std::min(level, supportedLevel());
+	return previous;
+}
+
+namespace detail
+{
+
+#ifdef PHASOR_SIMD_X86
+inline int lowestBit(unsigned mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// 64-bit lane equality with SSE2 only: both 32-bit halves must match
+inline __m128i cmpeq64(__m128i a, __m128i b)
+{
+	__m128i eq = _mm_cmpeq_epi32(a, b);
+	return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+PHASOR_TARGET_AVX2 inline bool equalIntsAvx2(const int64_t *a, const int64_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(x, y)) != -1)
+			return false;
+	}
+	for (; i < n; ++i)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+PHASOR_TARGET_AVX2 inline bool equalFloatsAvx2(const double *a, const double *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d eq = _mm256_cmp_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _CMP_EQ_OQ);
+		if (_mm256_movemask_pd(eq) != 0xF)
+			return false;
+	}
+	for (; i < n; ++i)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+PHASOR_TARGET_AVX2 inline int64_t sumIntsAvx2(const int64_t *a, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t  i   = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)));
+	alignas(32) uint64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+	uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i < n; ++i)
+		sum += static_cast<uint64_t>(a[i]);
+	return static_cast<int64_t>(sum);
+}
+
+PHASOR_TARGET_AVX2 inline double sumFloatsAvx2(const double *a, size_t n)
+{
+	__m256d acc = _mm256_setzero_pd();
+	size_t  i   = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, acc);
+	double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	for (; i < n; ++i)
+		sum += a[i];
+	return sum;
+}
+
+PHASOR_TARGET_AVX2 inline int64_t extremeIntAvx2(const int64_t *a, size_t n, bool wantMax)
+{
+	if (n < 4)
+		return wantMax ? *std::max_element(a, a + n) : *std::min_element(a, a + n);
+	__m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+	size_t  i    = 4;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x    = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i take = wantMax ? _mm256_cmpgt_epi64(x, best) : _mm256_cmpgt_epi64(best, x);
+		best         = _mm256_blendv_epi8(best, x, take);
+	}
+	alignas(32) int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), best);
+	int64_t result = lanes[0];
+	for (int64_t v : lanes)
+		result = wantMax ? std::max(result, v) : std::min(result, v);
+	for (; i < n; ++i)
+		result = wantMax ? std::max(result, a[i]) : std::min(result, a[i]);
+	return result;
+}
+
+PHASOR_TARGET_AVX2 inline double extremeFloatAvx2(const double *a, size_t n, bool wantMax)
+{
+	if (n < 4)
+		return wantMax ? *std::max_element(a, a + n) : *std::min_element(a, a + n);
+	__m256d best = _mm256_loadu_pd(a);
+	size_t  i    = 4;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(a + i);
+		best      = wantMax ? _mm256_max_pd(best, x) : _mm256_min_pd(best, x);
+	}
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, best);
+	double result = lanes[0];
+	for (double v : lanes)
+		result = wantMax ? std::max(result, v) : std::min(result, v);
+	for (; i < n; ++i)
+		result = wantMax ? std::max(result, a[i]) : std::min(result, a[i]);
+	return result;
+}
+
+PHASOR_TARGET_AVX2 inline int64_t findIntAvx2(const int64_t *a, size_t n, int64_t needle)
+{
+	__m256i key = _mm256_set1_epi64x(needle);
+	size_t  i   = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i eq   = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)), key);
+		int     mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+		if (mask)
+			return static_cast<int64_t>(i) + lowestBit(static_cast<unsigned>(mask));
+	}
+	for (; i < n; ++i)
+		if (a[i] == needle)
+			return static_cast<int64_t>(i);
+	return -1;
+}
+
+PHASOR_TARGET_AVX2 inline int64_t findFloatAvx2(const double *a, size_t n, double needle)
+{
+	__m256d key = _mm256_set1_pd(needle);
+	size_t  i   = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), key, _CMP_EQ_OQ));
+		if (mask)
+			return static_cast<int64_t>(i) + lowestBit(static_cast<unsigned>(mask));
+	}
+	for (; i < n; ++i)
+		if (a[i] == needle)
+			return static_cast<int64_t>(i);
+	return -1;
+}
+#endif
+
+} // namespace detail
+
+/// @brief Check two int64 ranges of length n for equality
+inline bool equalInts(const int64_t *a, const int64_t *b, size_t n)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::equalIntsAvx2(a, b, n);
+	if (activeLevel() == Level::Sse2)
+	{
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+			__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF)
+				return false;
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+/// @brief Check two double ranges of length n for equality (NaN never equal)
+inline bool equalFloats(const double *a, const double *b, size_t n)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::equalFloatsAvx2(a, b, n);
+	if (activeLevel() == Level::Sse2)
+	{
+		for (; i + 2 <= n; i += 2)
+			if (_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))) != 0x3)
+				return false;
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+/// @brief Sum int64 values with wrap-around on overflow
+inline int64_t sumInts(const int64_t *a, size_t n)
+{
+	size_t   i   = 0;
+	uint64_t sum = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::sumIntsAvx2(a, n);
+	if (activeLevel() == Level::Sse2)
+	{
+		__m128i acc = _mm_setzero_si128();
+		for (; i + 2 <= n; i += 2)
+			acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+		alignas(16) uint64_t lanes[2];
+		_mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+		sum = lanes[0] + lanes[1];
+	}
+#endif
+	for (; i < n; ++i)
+		sum += static_cast<uint64_t>(a[i]);
+	return static_cast<int64_t>(sum);
+}
+
+/// @brief Sum double values
+inline double sumFloats(const double *a, size_t n)
+{
+	size_t i   = 0;
+	double sum = 0.0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::sumFloatsAvx2(a, n);
+	if (activeLevel() == Level::Sse2)
+	{
+		__m128d acc = _mm_setzero_pd();
+		for (; i + 2 <= n; i += 2)
+			acc = _mm_add_pd(acc, _mm_loadu_pd(a + i));
+		alignas(16) double lanes[2];
+		_mm_store_pd(lanes, acc);
+		sum = lanes[0] + lanes[1];
+	}
+#endif
+	for (; i < n; ++i)
+		sum += a[i];
+	return sum;
+}
+
+/// @brief Smallest or largest of n > 0 int64 values
+inline int64_t extremeInt(const int64_t *a, size_t n, bool wantMax)
+{
+#ifdef PHASOR_SIMD_X86
+	// SSE2 has no 64-bit compare, so only AVX2 gets a vector path
+	if (activeLevel() == Level::Avx2)
+		return detail::extremeIntAvx2(a, n, wantMax);
+#endif
+	return wantMax ? *std::max_element(a, a + n) : *std::min_element(a, a + n);
+}
+
+/// @brief Smallest or largest of n > 0 double values
+inline double extremeFloat(const double *a, size_t n, bool wantMax)
+{
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::extremeFloatAvx2(a, n, wantMax);
+	if (activeLevel() == Level::Sse2 && n >= 2)
+	{
+		__m128d best = _mm_loadu_pd(a);
+		size_t  i    = 2;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d x = _mm_loadu_pd(a + i);
+			best      = wantMax ? _mm_max_pd(best, x) : _mm_min_pd(best, x);
+		}
+		alignas(16) double lanes[2];
+		_mm_store_pd(lanes, best);
+		double result = wantMax ? std::max(lanes[0], lanes[1]) : std::min(lanes[0], lanes[1]);
+		for (; i < n; ++i)
+			result = wantMax ? std::max(result, a[i]) : std::min(result, a[i]);
+		return result;
+	}
+#endif
+	return wantMax ? *std::max_element(a, a + n) : *std::min_element(a, a + n);
+}
+
+/// @brief Index of the first int64 equal to needle, or -1
+inline int64_t findInt(const int64_t *a, size_t n, int64_t needle)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::findIntAvx2(a, n, needle);
+	if (activeLevel() == Level::Sse2)
+	{
+		__m128i key = _mm_set1_epi64x(needle);
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128i eq   = detail::cmpeq64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)), key);
+			int     mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+			if (mask)
+				return static_cast<int64_t>(i) + detail::lowestBit(static_cast<unsigned>(mask));
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] == needle)
+			return static_cast<int64_t>(i);
+	return -1;
+}
+
+/// @brief Index of the first double equal to needle, or -1
+inline int64_t findFloat(const double *a, size_t n, double needle)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() == Level::Avx2)
+		return detail::findFloatAvx2(a, n, needle);
+	if (activeLevel() == Level::Sse2)
+	{
+		__m128d key = _mm_set1_pd(needle);
+		for (; i + 2 <= n; i += 2)
+		{
+			int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), key));
+			if (mask)
+				return static_cast<int64_t>(i) + detail::lowestBit(static_cast<unsigned>(mask));
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] == needle)
+			return static_cast<int64_t>(i);
+	return -1;
+}
+
+namespace detail
+{
+// Bytes escapeString() rewrites: control characters (and, where char is
+// signed, everything from 0x80 up), quotes, backslash and DEL
+inline bool needsEscape(char c)
+{
+	return c < 0x20 || c == '"' || c == '\\' || c == '\'' || c == 0x7F;
+}
+
+#ifdef PHASOR_SIMD_X86
+inline int escapeMask(__m128i v)
+{
+	__m128i ctrl;
+	if constexpr (std::is_signed_v<char>)
+		ctrl = _mm_cmplt_epi8(v, _mm_set1_epi8(0x20));
+	else
+		ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+	__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+	                                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F))));
+	return _mm_movemask_epi8(_mm_or_si128(ctrl, special));
+}
+
+PHASOR_TARGET_AVX2 inline size_t findEscapeAvx2(const char *p, size_t n)
+{
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		__m256i ctrl;
+		if constexpr (std::is_signed_v<char>)
+			ctrl = _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v);
+		else
+			ctrl = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F));
+		__m256i special =
+		    _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+		                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F))));
+		auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(ctrl, special)));
+		if (mask)
+			return i + static_cast<size_t>(lowestBit(mask));
+	}
+	for (; i < n; ++i)
+		if (needsEscape(p[i]))
+			return i;
+	return n;
+}
+#endif
+} // namespace detail
+
+/// @brief Index of the first byte escapeString() must rewrite, or n
+inline size_t findEscape(const char *p, size_t n)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (n >= 32 && activeLevel() == Level::Avx2)
+		return detail::findEscapeAvx2(p, n);
+	if (activeLevel() >= Level::Sse2)
+	{
+		for (; i + 16 <= n; i += 16)
+		{
+			int mask = detail::escapeMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)));
+			if (mask)
+				return i + static_cast<size_t>(detail::lowestBit(static_cast<unsigned>(mask)));
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		if (detail::needsEscape(p[i]))
+			return i;
+	return n;
+}
+
+/// @brief Element-wise arithmetic operator
+enum class Op
+{
+	Add,
+	Sub,
+	Mul
+};
+
+namespace detail
+{
+#ifdef PHASOR_SIMD_X86
+PHASOR_TARGET_AVX2 inline size_t applyIntsAvx2(Op op, const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+		                    op == Op::Add ? _mm256_add_epi64(x, y) : _mm256_sub_epi64(x, y));
+	}
+	return i;
+}
+
+PHASOR_TARGET_AVX2 inline size_t applyFloatsAvx2(Op op, const double *a, const double *b, double *out, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(a + i);
+		__m256d y = _mm256_loadu_pd(b + i);
+		_mm256_storeu_pd(out + i, op == Op::Add   ? _mm256_add_pd(x, y)
+		                          : op == Op::Sub ? _mm256_sub_pd(x, y)
+		                                          : _mm256_mul_pd(x, y));
+	}
+	return i;
+}
+#endif
+} // namespace detail
+
+/// @brief out[i] = a[i] op b[i] with wrap-around on overflow
+inline void applyInts(Op op, const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	// No 64-bit lane multiply below AVX-512, so Mul stays scalar
+	if (op != Op::Mul && activeLevel() >= Level::Sse2)
+	{
+		if (activeLevel() == Level::Avx2)
+			i = detail::applyIntsAvx2(op, a, b, out, n);
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+			__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), op == Op::Add ? _mm_add_epi64(x, y) : _mm_sub_epi64(x, y));
+		}
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		auto x = static_cast<uint64_t>(a[i]);
+		auto y = static_cast<uint64_t>(b[i]);
+		out[i] = static_cast<int64_t>(op == Op::Add ? x + y : op == Op::Sub ? x - y : x * y);
+	}
+}
+
+/// @brief out[i] = a[i] op b[i]
+inline void applyFloats(Op op, const double *a, const double *b, double *out, size_t n)
+{
+	size_t i = 0;
+#ifdef PHASOR_SIMD_X86
+	if (activeLevel() >= Level::Sse2)
+	{
+		if (activeLevel() == Level::Avx2)
+			i = detail::applyFloatsAvx2(op, a, b, out, n);
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d x = _mm_loadu_pd(a + i);
+			__m128d y = _mm_loadu_pd(b + i);
+			_mm_storeu_pd(out + i, op == Op::Add ? _mm_add_pd(x, y) : op == Op::Sub ? _mm_sub_pd(x, y) : _mm_mul_pd(x, y));
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		out[i] = op == Op::Add ? a[i] + b[i] : op == Op::Sub ? a[i] - b[i] : a[i] * b[i];
+}
+
+} // namespace Phasor::simd
@@ -1,89 +1,1282 @@
 #pragma once
-#include <iostream>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <unordered_map>
+#include <utility>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <iterator>
 #include <format>
-#include <string>
+
+#include "Heap.hpp"
+#include "Ref.hpp"
+#include "Simd.hpp"
+
+/// @brief Write `input` with control characters, quotes and backslashes escaped
+///
+/// Runs of bytes that need no escaping are found with Phasor::simd::findEscape
+/// and copied in bulk.
+template <typename OutputIt> OutputIt escapeTo(std::string_view input, OutputIt out)
+{
+	auto put = [&](std::string_view s) { out = std::copy(s.begin(), s.end(), out); };
+	size_t pos = 0;
+	while (pos < input.size())
+	{
+		size_t next = pos + Phasor::simd::findEscape(input.data() + pos, input.size() - pos);
+		put(input.substr(pos, next - pos));
+		if (next == input.size())
+			break;
+		char c = input[next];
+		pos    = next + 1;
+		switch (c)
+		{
+		case '\n': put("\\n");  break;
+		case '\t': put("\\t");  break;
+		case '\r': put("\\r");  break;
+		case '\0': put("\\0");  break;
+		case '\\': put("\\\\"); break;
+		case '\"': put("\\\""); break;
+		case '\'': put("\\'");  break;
+		case '\a': put("\\a");  break;
+		case '\b': put("\\b");  break;
+		case '\f': put("\\f");  break;
+		case '\v': put("\\v");  break;
+		default:
+		{
+			constexpr char hex[] = "0123456789ABCDEF";
+			auto           u     = static_cast<unsigned char>(c);
+			const char     buf[] = {'\\', 'x', hex[u >> 4], hex[u & 0xF]};
+			put(std::string_view(buf, sizeof(buf)));
+			break;
+		}
+		}
+	}
+	return out;
+}
+
+/// @brief Exact length of escapeString(input)
+inline size_t escapedSize(std::string_view input)
+{
+	size_t size = input.size();
+	size_t pos  = 0;
+	while (pos < input.size())
+	{
+		pos += Phasor::simd::findEscape(input.data() + pos, input.size() - pos);
+		if (pos == input.size())
+			break;
+		switch (input[pos])
+		{
+		case '\n': case '\t': case '\r': case '\0': case '\\':
+		case '\"': case '\'': case '\a': case '\b': case '\f': case '\v':
+			size += 1;
+			break;
+		default:
+			size += 3;
+			break;
+		}
+		++pos;
+	}
+	return size;
+}
 
 inline std::string escapeString(const std::string& input) {
 		std::string output;
-		output.reserve(input.size());
-
-		for (char c : input) {
-			switch (c) {
-				case '\n': output += "\\n";  break;
-				case '\t': output += "\\t";  break;
-				case '\r': output += "\\r";  break;
-				case '\0': output += "\\0";  break;
-				case '\\': output += "\\\\"; break;
-				case '\"': output += "\\\""; break;
-				case '\'': output += "\\'";  break;
-				case '\a': output += "\\a";  break;
-				case '\b': output += "\\b";  break;
-				case '\f': output += "\\f";  break;
-				case '\v': output += "\\v";  break;
-				default:
-					if (c < 0x20 || c == 0x7F) {
-						char buf[5];
-						snprintf(buf, sizeof(buf), "\\x%02X", (unsigned char)c);
-						output += buf;
-					} else {
-						output += c;
-					}
+		output.reserve(escapedSize(input));
+		escapeTo(input, std::back_inserter(output));
+    return output;
+}
+
+/// @brief The Phasor Programming Language and Runtime
+namespace Phasor
+{
+
+/**
+ * @brief Runtime value types for the VM
+ */
+enum class ValueType
+{
+	Null,
+	Bool,
+	Int,
+	Float,
+	String,
+	Struct,
+	Array,
+	Map
+};
+
+/**
+ * @brief Sharing semantics of an array
+ */
+enum class ArrayMode
+{
+	Shared,     ///< Copies of the Value alias one array
+	CopyOnWrite ///< Copies behave as independent arrays; storage is shared until mutated
+};
+
+/**
+ * @brief Hidden-class layout shared by struct instances
+ *
+ * Maps field names to slot indices. Adding a field follows a cached
+ * transition to a child shape, so instances that gain the same fields in the
+ * same order share one Shape. Shapes are never freed.
+ */
+class Shape
+{
+  public:
+	/// @brief Get the empty root shape for a struct name
+	static const Shape *root(const std::string &structName)
+	{
+		static std::unordered_map<std::string, std::unique_ptr<Shape>> roots;
+		auto &slot = roots[structName];
+		if (!slot)
+			slot.reset(new Shape(structName));
+		return slot.get();
+	}
+
+	/// @brief Get the struct name this shape belongs to
+	const std::string &structName() const
+	{
+		return name;
+	}
+
+	/// @brief Get the number of fields in this shape
+	size_t fieldCount() const
+	{
+		return names.size();
+	}
+
+	/// @brief Get the field names in slot order
+	const std::vector<std::string> &fieldNames() const
+	{
+		return names;
+	}
+
+	/// @brief Get the slot index of a field, or -1 if absent
+	int64_t slotOf(const std::string &field) const
+	{
+		auto it = slots.find(field);
+		if (it == slots.end())
+			return -1;
+		return static_cast<int64_t>(it->second);
+	}
+
+	/// @brief Get the shape reached by appending a field to this one
+	const Shape *withField(const std::string &field) const
+	{
+		auto &next = transitions[field];
+		if (!next)
+		{
+			next.reset(new Shape(name));
+			next->slots = slots;
+			next->names = names;
+			next->slots.emplace(field, names.size());
+			next->names.push_back(field);
+		}
+		return next.get();
+	}
+
+  private:
+	explicit Shape(std::string structName) : name(std::move(structName))
+	{
+	}
+
+	std::string                                                     name;
+	std::unordered_map<std::string, size_t>                         slots;
+	std::vector<std::string>                                        names;
+	mutable std::unordered_map<std::string, std::unique_ptr<Shape>> transitions;
+};
+
+/**
+ * @brief Hit/miss counters for field inline caches
+ */
+struct FieldCacheStats
+{
+	uint64_t hits   = 0;
+	uint64_t misses = 0;
+
+	/// @brief Fraction of lookups served from a cache, 0 if none yet
+	double hitRate() const
+	{
+		uint64_t total = hits + misses;
+		return total ? static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+	}
+
+	/// @brief Reset both counters
+	void reset()
+	{
+		hits   = 0;
+		misses = 0;
+	}
+};
+
+/**
+ * @brief Polymorphic inline cache for one field-access site
+ *
+ * Bound to a constant field name, it remembers the slot index for up to
+ * `Ways` shapes. A lookup on a remembered shape is a pointer compare and an
+ * indexed load; anything else falls back to Shape::slotOf and fills a way.
+ * For shapes that lack the field the way also remembers the shape reached by
+ * adding it, so a store that adds the field stays on the cached path.
+ */
+class FieldCache
+{
+  public:
+	static constexpr size_t Ways = 4;
+
+	explicit FieldCache(std::string field) : field(std::move(field))
+	{
+	}
+
+	/// @brief Get the field name this site accesses
+	const std::string &name() const
+	{
+		return field;
+	}
+
+	/// @brief Get the slot index of the field in a shape, or -1 if absent
+	int64_t lookup(const Shape *shape)
+	{
+		for (size_t i = 0; i < used; ++i)
+		{
+			if (shapes[i] == shape)
+			{
+				++stats().hits;
+				return slots[i];
+			}
+		}
+		++stats().misses;
+		int64_t slot = shape->slotOf(field);
+		size_t  way  = used < Ways ? used++ : next++ % Ways;
+		shapes[way]  = shape;
+		slots[way]   = slot;
+		targets[way] = nullptr;
+		return slot;
+	}
+
+	/// @brief Get the shape reached by adding the field to a shape that lacks it
+	const Shape *transition(const Shape *shape)
+	{
+		for (size_t i = 0; i < used; ++i)
+		{
+			if (shapes[i] == shape)
+			{
+				if (!targets[i])
+					targets[i] = shape->withField(field);
+				return targets[i];
+			}
+		}
+		return shape->withField(field);
+	}
+
+	/// @brief Check whether the site has seen a single shape only
+	bool isMonomorphic() const
+	{
+		return used == 1;
+	}
+
+	/// @brief Process-wide counters shared by every cache
+	static FieldCacheStats &stats()
+	{
+		static FieldCacheStats counters;
+		return counters;
+	}
+
+  private:
+	std::string                     field;
+	std::array<const Shape *, Ways> shapes{};
+	std::array<int64_t, Ways>       slots{};
+	std::array<const Shape *, Ways> targets{};
+	size_t                          used = 0;
+	size_t                          next = 0;
+};
+
+/**
+ * @brief A value in the Phasor VM
+ *
+ * Uses std::variant for type-safe union
+ */
+class Value
+{
+  public:
+	/// @brief Struct storage: a shared Shape plus one inline slot per field
+	struct StructInstance : RefCounted, HeapObject
+	{
+		const Shape      *shape;
+		HeapVector<Value> slots;
+
+		explicit StructInstance(const Shape *shape) : shape(shape)
+		{
+		}
+
+		/// @brief Get the struct name
+		const std::string &structName() const
+		{
+			return shape->structName();
+		}
+
+		/// @brief Find a field's slot, or nullptr if absent
+		Value *find(const std::string &name)
+		{
+			int64_t slot = shape->slotOf(name);
+			return slot < 0 ? nullptr : &slots[static_cast<size_t>(slot)];
+		}
+
+		/// @brief Find a field's slot, or nullptr if absent (const)
+		const Value *find(const std::string &name) const
+		{
+			int64_t slot = shape->slotOf(name);
+			return slot < 0 ? nullptr : &slots[static_cast<size_t>(slot)];
+		}
+
+		/// @brief Set a field, transitioning to a new shape if it is absent
+		void set(const std::string &name, Value value)
+		{
+			if (Value *existing = find(name))
+			{
+				*existing = std::move(value);
+				return;
+			}
+			shape = shape->withField(name);
+			slots.push_back(std::move(value));
+		}
+	};
+	/**
+	 * @brief Array storage
+	 *
+	 * Homogeneous int, float and bool arrays are stored packed (contiguous
+	 * int64_t, double, or a bitset) and fall back to generic Value storage on
+	 * the first write of a different type. An empty array takes the packed
+	 * kind of its first element.
+	 */
+	class ArrayInstance : public RefCounted, public HeapObject
+	{
+	  public:
+		enum class Kind
+		{
+			Generic,
+			Int,
+			Float,
+			Bool
+		};
+
+		/// @brief Element storage for each kind, allocated from the Heap
+		using Values = HeapVector<Value>;
+		using Ints   = HeapVector<int64_t>;
+		using Floats = HeapVector<double>;
+		using Bools  = HeapVector<bool>;
+
+		/// @brief Copies of the owning Value share storage until one mutates it
+		bool copyOnWrite = false;
+
+		ArrayInstance() = default;
+		ArrayInstance(std::initializer_list<Value> elements) : ArrayInstance(std::vector<Value>(elements))
+		{
+		}
+		ArrayInstance(Ints elements) : storage(std::move(elements))
+		{
+		}
+		ArrayInstance(Floats elements) : storage(std::move(elements))
+		{
+		}
+		ArrayInstance(const std::vector<int64_t> &elements) : storage(Ints(elements.begin(), elements.end()))
+		{
+		}
+		ArrayInstance(const std::vector<double> &elements) : storage(Floats(elements.begin(), elements.end()))
+		{
+		}
+		ArrayInstance(std::vector<Value> elements)
+		{
+			Kind k = elements.empty() ? Kind::Generic : kindOf(elements.front());
+			for (const auto &e : elements)
+			{
+				if (kindOf(e) != k)
+				{
+					k = Kind::Generic;
 					break;
+				}
+			}
+			switch (k)
+			{
+			case Kind::Int:
+				storage = pack<int64_t>(elements, &Value::asInt);
+				break;
+			case Kind::Float:
+				storage = pack<double>(elements, &Value::asFloat);
+				break;
+			case Kind::Bool:
+				storage = pack<bool>(elements, &Value::asBool);
+				break;
+			case Kind::Generic:
+				storage = Values(std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+				break;
+			}
+		}
+
+		/// @brief Get the storage kind
+		Kind kind() const
+		{
+			return static_cast<Kind>(storage.index());
+		}
+
+		size_t size() const
+		{
+			return std::visit([](const auto &v) { return v.size(); }, storage);
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		/// @brief Get an element (unchecked)
+		///
+		/// Returns a copy, as packed storage holds no Values; write elements
+		/// with set() or Value::setElement().
+		Value operator[](size_t index) const
+		{
+			switch (kind())
+			{
+			case Kind::Int:
+				return Value(std::get<Ints>(storage)[index]);
+			case Kind::Float:
+				return Value(std::get<Floats>(storage)[index]);
+			case Kind::Bool:
+				return Value(static_cast<bool>(std::get<Bools>(storage)[index]));
+			default:
+				return std::get<Values>(storage)[index];
+			}
+		}
+
+		/// @brief Get an element
+		Value at(size_t index) const
+		{
+			if (index >= size())
+				throw std::runtime_error("Array index out of bounds");
+			return (*this)[index];
+		}
+
+		/// @brief Replace an element
+		void set(size_t index, Value value)
+		{
+			if (index >= size())
+				throw std::runtime_error("Array index out of bounds");
+			if (!store(index, value))
+				generic()[index] = std::move(value);
+		}
+
+		/// @brief Append an element
+		void push_back(Value value)
+		{
+			adoptKind(value);
+			if (!append(value))
+				generic().push_back(std::move(value));
+		}
+
+		void pop_back()
+		{
+			std::visit([](auto &v) { v.pop_back(); }, storage);
+		}
+
+		/// @brief Random-access iterator yielding elements by value
+		class const_iterator
+		{
+		  public:
+			using iterator_concept  = std::random_access_iterator_tag;
+			using iterator_category = std::input_iterator_tag;
+			using value_type        = Value;
+			using difference_type   = std::ptrdiff_t;
+			using reference         = Value;
+
+			const_iterator() = default;
+
+			Value operator*() const
+			{
+				return (*array)[index];
+			}
+			Value operator[](difference_type n) const
+			{
+				return (*array)[index + n];
+			}
+
+			const_iterator &operator++()
+			{
+				++index;
+				return *this;
+			}
+			const_iterator operator++(int)
+			{
+				return const_iterator(array, index++);
+			}
+			const_iterator &operator--()
+			{
+				--index;
+				return *this;
+			}
+			const_iterator operator--(int)
+			{
+				return const_iterator(array, index--);
+			}
+			const_iterator &operator+=(difference_type n)
+			{
+				index += n;
+				return *this;
+			}
+			const_iterator &operator-=(difference_type n)
+			{
+				index -= n;
+				return *this;
+			}
+			friend const_iterator operator+(const_iterator it, difference_type n)
+			{
+				return it += n;
+			}
+			friend const_iterator operator+(difference_type n, const_iterator it)
+			{
+				return it += n;
+			}
+			friend const_iterator operator-(const_iterator it, difference_type n)
+			{
+				return it -= n;
+			}
+			friend difference_type operator-(const const_iterator &a, const const_iterator &b)
+			{
+				return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+			}
+
+			bool operator==(const const_iterator &other) const
+			{
+				return index == other.index;
+			}
+			auto operator<=>(const const_iterator &other) const
+			{
+				return index <=> other.index;
+			}
+
+		  private:
+			friend class ArrayInstance;
+			const_iterator(const ArrayInstance *array, size_t index) : array(array), index(index)
+			{
+			}
+
+			const ArrayInstance *array = nullptr;
+			size_t               index = 0;
+		};
+
+		const_iterator begin() const
+		{
+			return const_iterator(this, 0);
+		}
+		const_iterator end() const
+		{
+			return const_iterator(this, size());
+		}
+		const_iterator cbegin() const
+		{
+			return begin();
+		}
+		const_iterator cend() const
+		{
+			return end();
+		}
+
+		/// @brief Get the first element (unchecked)
+		Value front() const
+		{
+			return (*this)[0];
+		}
+
+		/// @brief Get the last element (unchecked)
+		Value back() const
+		{
+			return (*this)[size() - 1];
+		}
+
+		/// @brief Insert an element before `pos`
+		const_iterator insert(const_iterator pos, Value value)
+		{
+			if (pos.index > size())
+				throw std::runtime_error("Array index out of bounds");
+			adoptKind(value);
+			if (!insertPacked(pos.index, value))
+			{
+				auto &v = generic();
+				v.insert(v.begin() + static_cast<std::ptrdiff_t>(pos.index), std::move(value));
+			}
+			return const_iterator(this, pos.index);
+		}
+
+		/// @brief Remove the element at `pos`
+		const_iterator erase(const_iterator pos)
+		{
+			return erase(pos, pos + 1);
+		}
+
+		/// @brief Remove the elements in [first, last)
+		const_iterator erase(const_iterator first, const_iterator last)
+		{
+			if (first.index > last.index || last.index > size())
+				throw std::runtime_error("Array index out of bounds");
+			std::visit(
+			    [&](auto &v) {
+				    v.erase(v.begin() + static_cast<std::ptrdiff_t>(first.index),
+				            v.begin() + static_cast<std::ptrdiff_t>(last.index));
+			    },
+			    storage);
+			return const_iterator(this, first.index);
+		}
+
+		void clear()
+		{
+			storage = Values{};
+		}
+
+		void reserve(size_t n)
+		{
+			std::visit([n](auto &v) { v.reserve(n); }, storage);
+		}
+
+		/// @brief Packed int elements, or nullptr if not Kind::Int
+		const Ints *ints() const
+		{
+			return std::get_if<Ints>(&storage);
+		}
+
+		/// @brief Packed float elements, or nullptr if not Kind::Float
+		const Floats *floats() const
+		{
+			return std::get_if<Floats>(&storage);
+		}
+
+		/// @brief Packed bool elements, or nullptr if not Kind::Bool
+		const Bools *bools() const
+		{
+			return std::get_if<Bools>(&storage);
+		}
+
+		/// @brief Packed int elements for mutation, or nullptr if not Kind::Int
+		Ints *ints()
+		{
+			return std::get_if<Ints>(&storage);
+		}
+
+		/// @brief Packed float elements for mutation, or nullptr if not Kind::Float
+		Floats *floats()
+		{
+			return std::get_if<Floats>(&storage);
+		}
+
+		/// @brief Switch to generic storage and get the elements for mutation
+		Values &generic()
+		{
+			if (kind() != Kind::Generic)
+			{
+				Values out;
+				out.reserve(size());
+				for (size_t i = 0; i < size(); ++i)
+					out.push_back((*this)[i]);
+				storage = std::move(out);
+			}
+			return std::get<Values>(storage);
+		}
+
+		/// @brief Call `f` with each element, by reference where storage allows
+		template <typename F> void forEach(F &&f) const
+		{
+			if (auto *v = std::get_if<Values>(&storage))
+			{
+				for (const auto &e : *v)
+					f(e);
+				return;
+			}
+			for (size_t i = 0; i < size(); ++i)
+				f((*this)[i]);
+		}
+
+		/// @brief Copy the elements out as Values
+		std::vector<Value> toVector() const
+		{
+			if (auto *v = std::get_if<Values>(&storage))
+				return std::vector<Value>(v->begin(), v->end());
+			std::vector<Value> out;
+			out.reserve(size());
+			for (size_t i = 0; i < size(); ++i)
+				out.push_back((*this)[i]);
+			return out;
+		}
+
+		bool operator==(const ArrayInstance &other) const
+		{
+			if (size() != other.size())
+				return false;
+			if (auto *a = ints(), *b = other.ints(); a && b)
+				return simd::equalInts(a->data(), b->data(), a->size());
+			if (auto *a = floats(), *b = other.floats(); a && b)
+				return simd::equalFloats(a->data(), b->data(), a->size());
+			if (kind() == other.kind())
+				return storage == other.storage;
+			for (size_t i = 0; i < size(); ++i)
+				if ((*this)[i] != other[i])
+					return false;
+			return true;
+		}
+
+	  private:
+		using Storage = std::variant<Values, Ints, Floats, Bools>;
+
+		static Kind kindOf(const Value &v)
+		{
+			switch (v.getType())
+			{
+			case ValueType::Int:
+				return Kind::Int;
+			case ValueType::Float:
+				return Kind::Float;
+			case ValueType::Bool:
+				return Kind::Bool;
+			default:
+				return Kind::Generic;
+			}
+		}
+
+		template <typename T, typename Get> static HeapVector<T> pack(const std::vector<Value> &elements, Get get)
+		{
+			HeapVector<T> out;
+			out.reserve(elements.size());
+			for (const auto &e : elements)
+				out.push_back((e.*get)());
+			return out;
+		}
+
+		static Storage emptyOf(Kind k)
+		{
+			switch (k)
+			{
+			case Kind::Int:
+				return Ints{};
+			case Kind::Float:
+				return Floats{};
+			case Kind::Bool:
+				return Bools{};
+			default:
+				return Values{};
+			}
+		}
+
+		// Store into packed storage; false if the value does not fit it
+		bool store(size_t index, const Value &value)
+		{
+			switch (kind())
+			{
+			case Kind::Int:
+				if (!value.isInt())
+					return false;
+				std::get<Ints>(storage)[index] = value.asInt();
+				return true;
+			case Kind::Float:
+				if (!value.isFloat())
+					return false;
+				std::get<Floats>(storage)[index] = value.asFloat();
+				return true;
+			case Kind::Bool:
+				if (!value.isBool())
+					return false;
+				std::get<Bools>(storage)[index] = value.asBool();
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// An empty generic array takes the packed kind of its first element
+		void adoptKind(const Value &value)
+		{
+			if (auto *v = std::get_if<Values>(&storage); v && v->empty() && kindOf(value) != Kind::Generic)
+				storage = emptyOf(kindOf(value));
+		}
+
+		// Insert into packed storage; false if the value does not fit it
+		bool insertPacked(size_t index, const Value &value)
+		{
+			auto at = [index](auto &v) { return v.begin() + static_cast<std::ptrdiff_t>(index); };
+			switch (kind())
+			{
+			case Kind::Int:
+				if (!value.isInt())
+					return false;
+				{
+					auto &v = std::get<Ints>(storage);
+					v.insert(at(v), value.asInt());
+				}
+				return true;
+			case Kind::Float:
+				if (!value.isFloat())
+					return false;
+				{
+					auto &v = std::get<Floats>(storage);
+					v.insert(at(v), value.asFloat());
+				}
+				return true;
+			case Kind::Bool:
+				if (!value.isBool())
+					return false;
+				{
+					auto &v = std::get<Bools>(storage);
+					v.insert(at(v), value.asBool());
+				}
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// Append to packed storage; false if the value does not fit it
+		bool append(const Value &value)
+		{
+			switch (kind())
+			{
+			case Kind::Int:
+				if (!value.isInt())
+					return false;
+				std::get<Ints>(storage).push_back(value.asInt());
+				return true;
+			case Kind::Float:
+				if (!value.isFloat())
+					return false;
+				std::get<Floats>(storage).push_back(value.asFloat());
+				return true;
+			case Kind::Bool:
+				if (!value.isBool())
+					return false;
+				std::get<Bools>(storage).push_back(value.asBool());
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		Storage storage;
+	};
+
+	/**
+	 * @brief Open-addressing hash map keyed by Values
+	 *
+	 * Linear probing over a power-of-two table, with the key hash cached per
+	 * slot and tombstones for removed entries. Keys follow Value::operator== and
+	 * Value::hash, except that a struct key matches the same struct instance,
+	 * in line with its identity hash. A map used as a key is likewise matched
+	 * by identity. NaN is not equal to itself, so set() rejects a NaN key;
+	 * a NaN nested in an array key is stored but can never be found.
+	 */
+	class MapInstance : public RefCounted, public HeapObject
+	{
+	  public:
+		MapInstance() = default;
+
+		/// @brief Number of live entries
+		size_t size() const
+		{
+			return count;
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		/// @brief Get the value for a key, or nullptr if absent
+		Value *find(const Value &key)
+		{
+			int64_t i = locate(key, key.hash());
+			return i < 0 ? nullptr : &entries[static_cast<size_t>(i)].second;
+		}
+
+		const Value *find(const Value &key) const
+		{
+			return const_cast<MapInstance *>(this)->find(key);
+		}
+
+		/// @brief Get the value for a key, or null if absent
+		Value get(const Value &key) const
+		{
+			const Value *v = find(key);
+			return v ? *v : Value();
+		}
+
+		bool contains(const Value &key) const
+		{
+			return find(key) != nullptr;
+		}
+
+		/// @brief Insert or replace an entry
+		void set(const Value &key, Value value)
+		{
+			if (key.isFloat() && std::isnan(key.asFloat()))
+				throw std::runtime_error("NaN cannot be used as a map key");
+			size_t hash = key.hash();
+			if (int64_t i = locate(key, hash); i >= 0)
+			{
+				entries[static_cast<size_t>(i)].second = std::move(value);
+				return;
+			}
+			if ((count + tombstones + 1) * 4 > slots.size() * 3)
+				rehash(slots.empty() ? 8 : (count + 1) * 2 > slots.size() ? slots.size() * 2 : slots.size());
+
+			size_t mask = slots.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask)
+			{
+				Slot &slot = slots[i];
+				if (slot.state != State::Full)
+				{
+					if (slot.state == State::Deleted)
+						--tombstones;
+					slot       = Slot{hash, State::Full};
+					entries[i] = {key, std::move(value)};
+					++count;
+					return;
+				}
 			}
 		}
 
-    return output;
-}
+		/// @brief Remove an entry, returning whether it existed
+		bool remove(const Value &key)
+		{
+			int64_t i = locate(key, key.hash());
+			if (i < 0)
+				return false;
+			slots[static_cast<size_t>(i)].state = State::Deleted;
+			entries[static_cast<size_t>(i)]     = {};
+			--count;
+			++tombstones;
+			return true;
+		}
+
+		void clear()
+		{
+			slots.clear();
+			entries.clear();
+			count      = 0;
+			tombstones = 0;
+		}
+
+		/// @brief Call `f(key, value)` for every entry, in table order
+		template <typename F> void forEach(F &&f) const
+		{
+			for (size_t i = 0; i < slots.size(); ++i)
+				if (slots[i].state == State::Full)
+					f(entries[i].first, entries[i].second);
+		}
+
+		/// @brief All keys as an array Value
+		Value keys() const
+		{
+			std::vector<Value> out;
+			out.reserve(count);
+			forEach([&](const Value &k, const Value &) { out.push_back(k); });
+			return createArray(std::move(out));
+		}
+
+	  private:
+		enum class State : uint8_t
+		{
+			Empty,
+			Full,
+			Deleted
+		};
+
+		// Probed metadata, kept apart from the entries so a probe only
+		// touches keys whose hash matches
+		struct Slot
+		{
+			size_t hash  = 0;
+			State  state = State::Empty;
+		};
+
+		int64_t locate(const Value &key, size_t hash) const
+		{
+			if (slots.empty())
+				return -1;
+			size_t mask = slots.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask)
+			{
+				const Slot &slot = slots[i];
+				if (slot.state == State::Empty)
+					return -1;
+				if (slot.state == State::Full && slot.hash == hash && sameKey(entries[i].first, key))
+					return static_cast<int64_t>(i);
+			}
+		}
+
+		// Value::operator== with structs, also inside arrays, compared by identity
+		static bool sameKey(const Value &a, const Value &b)
+		{
+			if (a == b)
+				return true;
+			if (a.isStruct() && b.isStruct())
+				return a.asStruct().get() == b.asStruct().get();
+			if (!a.isArray() || !b.isArray() || a.asArray()->size() != b.asArray()->size())
+				return false;
+			const auto &x = *a.asArray(), &y = *b.asArray();
+			for (size_t i = 0; i < x.size(); ++i)
+				if (!sameKey(x[i], y[i]))
+					return false;
+			return true;
+		}
+
+		void rehash(size_t capacity)
+		{
+			HeapVector<Slot>                    oldSlots   = std::move(slots);
+			HeapVector<std::pair<Value, Value>> oldEntries = std::move(entries);
+			slots.assign(capacity, Slot{});
+			entries.assign(capacity, {});
+			tombstones  = 0;
+			size_t mask = capacity - 1;
+			for (size_t j = 0; j < oldSlots.size(); ++j)
+			{
+				if (oldSlots[j].state != State::Full)
+					continue;
+				size_t i = oldSlots[j].hash & mask;
+				while (slots[i].state == State::Full)
+					i = (i + 1) & mask;
+				slots[i]   = oldSlots[j];
+				entries[i] = std::move(oldEntries[j]);
+			}
+		}
+
+		HeapVector<Slot>                    slots;
+		HeapVector<std::pair<Value, Value>> entries;
+		size_t                              count      = 0;
+		size_t                              tombstones = 0;
+	};
+
+	/**
+	 * @brief Append-only string buffer shared by string slices
+	 *
+	 * Bytes already covered by a slice never change, and the storage is
+	 * allocated once with a fixed capacity, so views and c_str() pointers into
+	 * it stay valid while it grows. Concatenation onto the slice that ends the
+	 * buffer appends in place while there is room, so building a string in a
+	 * loop costs amortized O(1) per piece. Once c_str() has handed out a
+	 * pointer the buffer is pinned and no longer grows. With
+	 * PHASOR_ATOMIC_REFCOUNT buffers may be shared across threads, so they
+	 * are never appended to or pinned. The bytes come from the Heap.
+	 *
+	 * A buffer can instead borrow external bytes, such as a memory-mapped
+	 * file, kept alive by `owner`. Borrowed buffers are always pinned.
+	 */
+	struct StringInstance : RefCounted, HeapObject
+	{
+		char                       *storage  = nullptr;
+		size_t                      size     = 0;
+		size_t                      capacity = 0;
+		bool                        pinned   = false;
+		std::string_view            external;
+		std::shared_ptr<const void> owner;
+
+		/// @brief Copy `bytes` into new storage with room for `capacity` bytes
+		StringInstance(std::string_view bytes, size_t capacity)
+		    : storage(HeapAllocator<char>().allocate(capacity + 1)), size(bytes.size()), capacity(capacity)
+		{
+			bytes.copy(storage, size);
+			storage[size] = '\0';
+		}
+		explicit StringInstance(std::string_view bytes) : StringInstance(bytes, bytes.size())
+		{
+		}
+		StringInstance(std::string_view external, std::shared_ptr<const void> owner)
+		    : pinned(true), external(external), owner(std::move(owner))
+		{
+		}
+		~StringInstance()
+		{
+			if (storage)
+				HeapAllocator<char>().deallocate(storage, capacity + 1);
+		}
+
+		StringInstance(const StringInstance &)            = delete;
+		StringInstance &operator=(const StringInstance &) = delete;
 
-/// @brief The Phasor Programming Language and Runtime
-namespace Phasor
-{
+		/// @brief Get the buffer contents
+		std::string_view contents() const
+		{
+			return owner ? external : std::string_view(storage, size);
+		}
 
-/**
- * @brief Runtime value types for the VM
- */
-enum class ValueType
-{
-	Null,
-	Bool,
-	Int,
-	Float,
-	String,
-	Struct,
-	Array
-};
+		/// @brief Append `bytes` if they fit in the remaining capacity
+		bool append(std::string_view bytes)
+		{
+			if (pinned || owner || bytes.size() > capacity - size)
+				return false;
+			bytes.copy(storage + size, bytes.size());
+			size += bytes.size();
+			storage[size] = '\0';
+			return true;
+		}
+	};
 
-/**
- * @brief A value in the Phasor VM
- *
- * Uses std::variant for type-safe union
- */
-class Value
-{
-  public:
-	struct StructInstance
+	/// @brief A string value referencing a range of a shared buffer
+	struct StringSlice
 	{
-		std::string                            structName;
-		std::unordered_map<std::string, Value> fields;
+		Ref<StringInstance> buffer;
+		size_t              offset;
+		size_t              length;
+
+		StringSlice(Ref<StringInstance> buffer, size_t offset, size_t length)
+		    : buffer(std::move(buffer)), offset(offset), length(length)
+		{
+		}
+		// Copies share the buffer but make their own c_str() copy
+		StringSlice(const StringSlice &other) : StringSlice(other.buffer, other.offset, other.length)
+		{
+		}
+		StringSlice(StringSlice &&other) noexcept
+		    : buffer(std::move(other.buffer)), offset(other.offset), length(other.length),
+		      terminated(other.terminated.exchange(nullptr))
+		{
+		}
+		StringSlice &operator=(const StringSlice &other)
+		{
+			if (this != &other)
+			{
+				buffer = other.buffer;
+				offset = other.offset;
+				length = other.length;
+				delete terminated.exchange(nullptr);
+			}
+			return *this;
+		}
+		StringSlice &operator=(StringSlice &&other) noexcept
+		{
+			if (this != &other)
+			{
+				buffer = std::move(other.buffer);
+				offset = other.offset;
+				length = other.length;
+				delete terminated.exchange(other.terminated.exchange(nullptr));
+			}
+			return *this;
+		}
+		~StringSlice()
+		{
+			delete terminated.load();
+		}
+
+		std::string_view view() const
+		{
+			return buffer->contents().substr(offset, length);
+		}
+
+		/// @brief Get a NUL-terminated copy of the bytes, made on first use
+		///
+		/// The buffer is left alone, so earlier view() results stay valid, and
+		/// concurrent callers agree on a single copy.
+		const char *c_str() const
+		{
+			std::string *copy = terminated.load(std::memory_order_acquire);
+			if (!copy)
+			{
+				auto *fresh = new std::string(view());
+				if (terminated.compare_exchange_strong(copy, fresh, std::memory_order_acq_rel))
+					copy = fresh;
+				else
+					delete fresh;
+			}
+			return copy->c_str();
+		}
+
+	  private:
+		mutable std::atomic<std::string *> terminated{nullptr};
 	};
-	using ArrayInstance = std::vector<Value>;
+
+	/// @brief Substrings shorter than this are copied instead of sliced
+	static constexpr size_t SliceThreshold = 32;
 
   private:
-	using DataType = std::variant<std::monostate, bool, int64_t, double, std::string, std::shared_ptr<StructInstance>,
-	                              std::shared_ptr<ArrayInstance>>;
+	using DataType = std::variant<std::monostate, bool, int64_t, double, std::string, Ref<StructInstance>,
+	                              Ref<ArrayInstance>, StringSlice, Ref<MapInstance>>;
 
 	DataType data;
 
+	explicit Value(StringSlice s) : data(std::move(s))
+	{
+	}
+
+#ifdef PHASOR_ATOMIC_REFCOUNT
+	static constexpr bool GrowInPlace = false;
+#else
+	static constexpr bool GrowInPlace = true;
+#endif
+
+	// Concatenate two strings, growing this string's buffer in place when
+	// this value is the slice that ends it and the buffer has room
+	Value concat(const Value &other) const
+	{
+		std::string_view rhs      = other.view();
+		auto            *s        = std::get_if<StringSlice>(&data);
+		bool             growable = false;
+		if (GrowInPlace && s)
+		{
+			auto &buf = *s->buffer;
+			growable  = !buf.pinned && !buf.owner && s->offset + s->length == buf.size;
+			if (growable && buf.append(rhs))
+				return Value(StringSlice{s->buffer, s->offset, s->length + rhs.size()});
+		}
+
+		std::string_view lhs = view();
+		size_t           len = lhs.size() + rhs.size();
+		if (len < SliceThreshold)
+		{
+			std::string out;
+			out.reserve(len);
+			out.append(lhs).append(rhs);
+			return Value(std::move(out));
+		}
+		// Only a string that is being grown gets spare capacity
+		auto buffer = makeRef<StringInstance>(lhs, growable ? 2 * len : len);
+		buffer->append(rhs);
+		return Value(StringSlice{std::move(buffer), 0, len});
+	}
+
+	// Slice this string; only a string that is already a slice shares its
+	// buffer, owned strings are copied so that *this never changes
+	Value slice(size_t pos, size_t length) const
+	{
+		auto *s = std::get_if<StringSlice>(&data);
+		if (!s || length < SliceThreshold)
+			return Value(std::string(view().substr(pos, length)));
+		return Value(StringSlice{s->buffer, s->offset + pos, length});
+	}
+
+	// Get this string as a slice, copying an owned string into a new buffer
+	Value asSlice() const
+	{
+		if (std::holds_alternative<StringSlice>(data))
+			return *this;
+		std::string_view v = view();
+		return Value(StringSlice{makeRef<StringInstance>(v), 0, v.size()});
+	}
+
   public:
 	/// @brief Default constructor
 	Value() : data(std::monostate{})
 	{
 	}
+	Value(const Value &) = default;
+	Value(Value &&)      = default;
+	// Assigning to a temporary is rejected, so writes such as
+	// `(*v.asArray())[i] = x` fail to compile instead of doing nothing
+	Value &operator=(const Value &) & = default;
+	Value &operator=(Value &&) &      = default;
 	/// @brief Boolean constructor
 	Value(bool b) : data(b)
 	{
@@ -105,15 +1298,23 @@ class Value
 	{
 	}
 	/// @brief String constructor
+	Value(std::string &&s) : data(std::move(s))
+	{
+	}
+	/// @brief String constructor
 	Value(const char *s) : data(std::string(s))
 	{
 	}
 	/// @brief Struct constructor
-	Value(std::shared_ptr<StructInstance> s) : data(std::move(s))
+	Value(Ref<StructInstance> s) : data(std::move(s))
 	{
 	}
 	/// @brief Array constructor
-	Value(std::shared_ptr<ArrayInstance> a) : data(std::move(a))
+	Value(Ref<ArrayInstance> a) : data(std::move(a))
+	{
+	}
+	/// @brief Map constructor
+	Value(Ref<MapInstance> m) : data(std::move(m))
 	{
 	}
 
@@ -128,12 +1329,14 @@ class Value
 			return ValueType::Int;
 		if (std::holds_alternative<double>(data))
 			return ValueType::Float;
-		if (std::holds_alternative<std::string>(data))
+		if (std::holds_alternative<std::string>(data) || std::holds_alternative<StringSlice>(data))
 			return ValueType::String;
-		if (std::holds_alternative<std::shared_ptr<StructInstance>>(data))
+		if (std::holds_alternative<Ref<StructInstance>>(data))
 			return ValueType::Struct;
-		if (std::holds_alternative<std::shared_ptr<ArrayInstance>>(data))
+		if (std::holds_alternative<Ref<ArrayInstance>>(data))
 			return ValueType::Array;
+		if (std::holds_alternative<Ref<MapInstance>>(data))
+			return ValueType::Map;
 		return ValueType::Null; // Should not be reached if default constructed
 	}
 
@@ -155,6 +1358,8 @@ class Value
 			return Value("struct");
 		case ValueType::Array:
 			return Value("array");
+		case ValueType::Map:
+			return Value("map");
 		default:
 			return Value("unknown");
 		}
@@ -193,7 +1398,12 @@ class Value
 	/// @brief Check if the value is an array
 	bool isArray() const
 	{
-		return std::holds_alternative<std::shared_ptr<ArrayInstance>>(data);
+		return std::holds_alternative<Ref<ArrayInstance>>(data);
+	}
+	/// @brief Check if the value is a map
+	bool isMap() const
+	{
+		return std::holds_alternative<Ref<MapInstance>>(data);
 	}
 
 	/// @brief Get the value as a boolean
@@ -222,20 +1432,98 @@ class Value
 	/// @brief Get the value as a string
 	std::string asString() const
 	{
-		if (isString())
-			return std::get<std::string>(data);
+		if (auto *s = std::get_if<std::string>(&data))
+			return *s;
+		if (auto *s = std::get_if<StringSlice>(&data))
+			return std::string(s->view());
 		return toString();
 	}
-	/// @brief Get the value as an array
-	std::shared_ptr<ArrayInstance> asArray()
+
+	/// @brief View the bytes of a string value without copying
+	std::string_view view() const
+	{
+		if (auto *s = std::get_if<std::string>(&data))
+			return *s;
+		if (auto *s = std::get_if<StringSlice>(&data))
+			return s->view();
+		throw std::runtime_error("view() can only be called on string values");
+	}
+
+	/// @brief Get up to `length` bytes starting at `pos`
+	///
+	/// When this string is a slice, results of SliceThreshold bytes or more
+	/// share its buffer.
+	Value substr(size_t pos, size_t length = std::string::npos) const
+	{
+		std::string_view v = view();
+		if (pos > v.size())
+			throw std::runtime_error("substr() position out of range");
+		return slice(pos, std::min(length, v.size() - pos));
+	}
+
+	/// @brief Strip leading and trailing whitespace
+	Value trim() const
+	{
+		constexpr std::string_view space = " \t\r\n\f\v";
+		std::string_view           v     = view();
+		size_t                     begin = v.find_first_not_of(space);
+		if (begin == std::string_view::npos)
+			return Value("");
+		size_t end = v.find_last_not_of(space) + 1;
+		return slice(begin, end - begin);
+	}
+
+	/// @brief Split into an array of lines, dropping "\n" and "\r\n" terminators
+	Value splitLines() const
+	{
+		// Lines share one buffer even when this string is owned
+		Value              whole = asSlice();
+		std::string_view   v     = whole.view();
+		std::vector<Value> lines;
+		size_t             pos = 0;
+		while (pos < v.size())
+		{
+			size_t nl  = v.find('\n', pos);
+			size_t end = nl == std::string_view::npos ? v.size() : nl;
+			size_t len = end - pos;
+			if (len && v[end - 1] == '\r')
+				--len;
+			lines.push_back(whole.slice(pos, len));
+			pos = end + 1;
+		}
+		return createArray(std::move(lines));
+	}
+
+	/// @brief Check whether a string value starts with `prefix`
+	bool startsWith(std::string_view prefix) const
+	{
+		return view().starts_with(prefix);
+	}
+
+	/// @brief Check whether a string value ends with `suffix`
+	bool endsWith(std::string_view suffix) const
+	{
+		return view().ends_with(suffix);
+	}
+	/// @brief Get the value as an array, read-only
+	///
+	/// Writes go through mutableArray(), setElement() or pushElement() so that
+	/// copy-on-write arrays are detached first.
+	const Ref<const ArrayInstance> asArray() const
+	{
+		return std::get<Ref<ArrayInstance>>(data);
+	}
+
+	/// @brief Get the value as a map
+	Ref<MapInstance> asMap()
 	{
-		return std::get<std::shared_ptr<ArrayInstance>>(data);
+		return std::get<Ref<MapInstance>>(data);
 	}
 
-	/// @brief Get the value as an array (const)
-	const std::shared_ptr<const ArrayInstance> asArray() const
+	/// @brief Get the value as a map (const)
+	const Ref<const MapInstance> asMap() const
 	{
-		return std::get<std::shared_ptr<ArrayInstance>>(data);
+		return std::get<Ref<MapInstance>>(data);
 	}
 
 	/// @brief Add two values
@@ -246,7 +1534,7 @@ class Value
 		if (isNumber() && other.isNumber())
 			return Value(asFloat() + other.asFloat());
 		if (isString() && other.isString())
-			return Value(asString() + other.asString());
+			return concat(other);
 		throw std::runtime_error("Cannot add these value types");
 	}
 
@@ -340,10 +1628,53 @@ class Value
 		if (isFloat())
 			return asFloat() != 0.0;
 		if (isString())
-    		return !asString().empty();
+			return !view().empty();
 		return false;
 	}
 
+	/// @brief Hash consistent with operator==
+	///
+	/// Ints and floats never compare equal, so they hash independently;
+	/// -0.0 hashes like 0.0. Arrays hash their elements, so packed and
+	/// generic arrays of equal contents collide. Structs only compare equal
+	/// to nothing and hash by identity, as do maps.
+	size_t hash() const
+	{
+		auto mix = [](uint64_t x) {
+			x += 0x9E3779B97F4A7C15ull;
+			x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+			x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+			return static_cast<size_t>(x ^ (x >> 31));
+		};
+		switch (getType())
+		{
+		case ValueType::Null:
+			return mix(0);
+		case ValueType::Bool:
+			return mix(asBool() ? 1 : 2);
+		case ValueType::Int:
+			return mix(static_cast<uint64_t>(asInt()));
+		case ValueType::Float:
+		{
+			double d = asFloat();
+			return mix(std::bit_cast<uint64_t>(d == 0.0 ? 0.0 : d));
+		}
+		case ValueType::String:
+			return std::hash<std::string_view>{}(view());
+		case ValueType::Array:
+		{
+			size_t h = mix(asArray()->size());
+			asArray()->forEach([&](const Value &e) { h = mix(h ^ e.hash()); });
+			return h;
+		}
+		case ValueType::Struct:
+			return mix(reinterpret_cast<uintptr_t>(asStruct().get()));
+		case ValueType::Map:
+			return mix(reinterpret_cast<uintptr_t>(asMap().get()));
+		}
+		return 0;
+	}
+
 	/// @brief Comparison operations
 	bool operator==(const Value &other) const
 	{
@@ -358,7 +1689,7 @@ class Value
 		if (isFloat())
 			return asFloat() == other.asFloat();
 		if (isString())
-			return asString() == other.asString();
+			return view() == other.view();
 		if (isArray())
 		{
 			if (!other.isArray())
@@ -367,6 +1698,9 @@ class Value
 			const auto &other_arr = *other.asArray();
 			return self_arr == other_arr;
 		}
+		// Maps are mutable containers and compare by identity, like their hash
+		if (isMap())
+			return asMap().get() == other.asMap().get();
 		return false;
 	}
 
@@ -384,7 +1718,7 @@ class Value
 		if (isNumber() && other.isNumber())
 			return asFloat() < other.asFloat();
 		if (isString() && other.isString())
-			return asString() < other.asString();
+			return view() < other.view();
 		throw std::runtime_error("Cannot compare these value types ");
 	}
 
@@ -396,7 +1730,7 @@ class Value
 		if (isNumber() && other.isNumber())
 			return asFloat() > other.asFloat();
 		if (isString() && other.isString())
-			return asString() > other.asString();
+			return view() > other.view();
 		throw std::runtime_error("Cannot compare these value types ");
 	}
 
@@ -414,32 +1748,74 @@ class Value
 	/// @brief Convert to string for printing
 	std::string toString() const
 	{
-		if (isNull())
-			return "null";
-		if (isBool())
-			return asBool() ? "true" : "false";
-		if (isInt())
-			return std::to_string(asInt());
-		if (isFloat())
-			return std::to_string(asFloat());
-		if (isString())
-			return asString();
-		if (isArray())
+		std::string result;
+		formatTo(std::back_inserter(result));
+		return result;
+	}
+
+	/// @brief Write the toString() form to an output iterator without temporaries
+	template <typename OutputIt> OutputIt formatTo(OutputIt out) const
+	{
+		auto put = [&](std::string_view s) { out = std::copy(s.begin(), s.end(), out); };
+		switch (getType())
 		{
-			std::string result = "[";
-			const auto &arr = *asArray();
-			for (size_t i = 0; i < arr.size(); ++i)
-			{
-				result += arr[i].toString();
-				if (i < arr.size() - 1)
-				{
-					result += ", ";
-				}
-			}
-			result += "]";
-			return result;
+		case ValueType::Null:
+			put("null");
+			break;
+		case ValueType::Bool:
+			put(asBool() ? "true" : "false");
+			break;
+		case ValueType::Int:
+		{
+			char buf[24];
+			auto res = std::to_chars(buf, buf + sizeof(buf), asInt());
+			put(std::string_view(buf, static_cast<size_t>(res.ptr - buf)));
+			break;
+		}
+		case ValueType::Float:
+		{
+			// Same digits as std::to_string: fixed notation, six decimals
+			char buf[400];
+			auto res = std::to_chars(buf, buf + sizeof(buf), asFloat(), std::chars_format::fixed, 6);
+			put(std::string_view(buf, static_cast<size_t>(res.ptr - buf)));
+			break;
+		}
+		case ValueType::String:
+			put(view());
+			break;
+		case ValueType::Array:
+		{
+			bool first = true;
+			*out++     = '[';
+			asArray()->forEach([&](const Value &e) {
+				if (!first)
+					put(", ");
+				first = false;
+				out   = e.formatTo(out);
+			});
+			*out++ = ']';
+			break;
+		}
+		case ValueType::Map:
+		{
+			bool first = true;
+			*out++     = '{';
+			asMap()->forEach([&](const Value &k, const Value &e) {
+				if (!first)
+					put(", ");
+				first = false;
+				out   = k.formatTo(out);
+				put(": ");
+				out = e.formatTo(out);
+			});
+			*out++ = '}';
+			break;
+		}
+		default:
+			put("unknown");
+			break;
 		}
-		return "unknown";
+		return out;
 	}
 
 	/// @brief Convert to C Style String
@@ -447,7 +1823,16 @@ class Value
 	{
 		if (!isString())
 			throw std::runtime_error("c_str() can only be called on string values");
-		return std::get<std::string>(data).c_str();
+		auto *s = std::get_if<StringSlice>(&data);
+		if (!s)
+			return std::get<std::string>(data).c_str();
+		// A slice running to the end of an owned buffer is already NUL-terminated
+		if (GrowInPlace && !s->buffer->owner && s->offset + s->length == s->buffer->size)
+		{
+			s->buffer->pinned = true;
+			return s->buffer->storage + s->offset;
+		}
+		return s->c_str();
 	}
 
 	/// @brief Print to output stream
@@ -459,64 +1844,161 @@ class Value
 
 	bool isStruct() const
 	{
-		return std::holds_alternative<std::shared_ptr<StructInstance>>(data);
+		return std::holds_alternative<Ref<StructInstance>>(data);
 	}
 
-	std::shared_ptr<StructInstance> asStruct()
+	Ref<StructInstance> asStruct()
 	{
-		return std::get<std::shared_ptr<StructInstance>>(data);
+		return std::get<Ref<StructInstance>>(data);
 	}
 
-	const std::shared_ptr<const StructInstance> asStruct() const
+	const Ref<const StructInstance> asStruct() const
 	{
-		return std::get<std::shared_ptr<StructInstance>>(data);
+		return std::get<Ref<StructInstance>>(data);
 	}
 
 	static Value createStruct(const std::string &name)
 	{
-		return Value(std::make_shared<StructInstance>(StructInstance{.structName = name, .fields = {}}));
+		return Value(makeRef<StructInstance>(Shape::root(name)));
+	}
+
+	/// @brief Create a string value referencing `length` bytes of a buffer
+	static Value createSlice(Ref<StringInstance> buffer, size_t offset, size_t length)
+	{
+		if (offset > buffer->contents().size() || length > buffer->contents().size() - offset)
+			throw std::runtime_error("String slice out of range");
+		return Value(StringSlice{std::move(buffer), offset, length});
+	}
+
+	/// @brief Create an empty map
+	static Value createMap()
+	{
+		return Value(makeRef<MapInstance>());
+	}
+
+	static Value createArray(std::vector<Value> elements = {}, ArrayMode mode = ArrayMode::Shared)
+	{
+		auto arr         = makeRef<ArrayInstance>(std::move(elements));
+		arr->copyOnWrite = mode == ArrayMode::CopyOnWrite;
+		return Value(std::move(arr));
+	}
+
+	/// @brief Get an independent copy of an array
+	///
+	/// Copy-on-write arrays are shared until one side mutates; shared arrays
+	/// are copied once into a new copy-on-write array.
+	Value copyArray() const
+	{
+		const auto &arr = std::get<Ref<ArrayInstance>>(data);
+		if (arr->copyOnWrite)
+			return *this;
+		auto copy         = makeRef<ArrayInstance>(*arr);
+		copy->copyOnWrite = true;
+		return Value(std::move(copy));
+	}
+
+	/// @brief Get the array for mutation
+	///
+	/// A copy-on-write array still shared with other Values is detached
+	/// first. Copy-on-write arrays must only be mutated through here.
+	ArrayInstance &mutableArray()
+	{
+		auto &arr = std::get<Ref<ArrayInstance>>(data);
+		if (arr->copyOnWrite && arr.useCount() > 1)
+			arr = makeRef<ArrayInstance>(*arr);
+		return *arr;
 	}
 
-	static Value createArray(std::vector<Value> elements = {})
+	/// @brief Set an array element
+	void setElement(size_t index, Value value)
 	{
-		return Value(std::make_shared<ArrayInstance>(std::move(elements)));
+		mutableArray().set(index, std::move(value));
+	}
+
+	/// @brief Append an array element
+	void pushElement(Value value)
+	{
+		mutableArray().push_back(std::move(value));
 	}
 
 	Value getField(const std::string &name) const
 	{
-		if (!std::holds_alternative<std::shared_ptr<StructInstance>>(data))
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
 			throw std::runtime_error("getField() called on non-struct value");
-		auto s = std::get<std::shared_ptr<StructInstance>>(data);
-		auto it = s->fields.find(name);
-		if (it == s->fields.end())
+		const auto &s = std::get<Ref<StructInstance>>(data);
+		const Value *field = s->find(name);
+		if (!field)
 			return Value();
-		return it->second;
+		return *field;
 	}
 
 	void setField(const std::string &name, Value value)
 	{
-		if (!std::holds_alternative<std::shared_ptr<StructInstance>>(data))
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
 			throw std::runtime_error("setField() called on non-struct value");
-		auto s = std::get<std::shared_ptr<StructInstance>>(data);
-		s->fields[name] = std::move(value);
+		const auto &s = std::get<Ref<StructInstance>>(data);
+		s->set(name, std::move(value));
 	}
 
 	bool hasField(const std::string &name) const
 	{
-		if (!std::holds_alternative<std::shared_ptr<StructInstance>>(data))
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
+			return false;
+		const auto &s = std::get<Ref<StructInstance>>(data);
+		return s->shape->slotOf(name) >= 0;
+	}
+
+	Value getField(FieldCache &cache) const
+	{
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
+			throw std::runtime_error("getField() called on non-struct value");
+		const auto &s    = std::get<Ref<StructInstance>>(data);
+		int64_t     slot = cache.lookup(s->shape);
+		if (slot < 0)
+			return Value();
+		return s->slots[static_cast<size_t>(slot)];
+	}
+
+	void setField(FieldCache &cache, Value value)
+	{
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
+			throw std::runtime_error("setField() called on non-struct value");
+		const auto &s    = std::get<Ref<StructInstance>>(data);
+		int64_t     slot = cache.lookup(s->shape);
+		if (slot < 0)
+		{
+			s->shape = cache.transition(s->shape);
+			s->slots.push_back(std::move(value));
+		}
+		else
+			s->slots[static_cast<size_t>(slot)] = std::move(value);
+	}
+
+	bool hasField(FieldCache &cache) const
+	{
+		if (!std::holds_alternative<Ref<StructInstance>>(data))
 			return false;
-		auto s = std::get<std::shared_ptr<StructInstance>>(data);
-		return s->fields.find(name) != s->fields.end();
+		return cache.lookup(std::get<Ref<StructInstance>>(data)->shape) >= 0;
 	}
 };
 } // namespace Phasor
 
+template <>
+struct std::hash<Phasor::Value>
+{
+    size_t operator()(const Phasor::Value &v) const
+    {
+        return v.hash();
+    }
+};
+
 template <>
 struct std::formatter<Phasor::Value>
 {
     enum class Style { Value, TypeOnly, TypeValue, Debug, Quoted };
-    Style            style       = Style::Value;
-    std::string_view passthrough;
+    Style                  style = Style::Value;
+    std::array<char, 64>   spec{};      // "{:<passthrough>}", built once by parse()
+    std::size_t            specLen = 0;
 
     constexpr auto parse(std::format_parse_context &ctx)
 	{
@@ -541,107 +2023,199 @@ struct std::formatter<Phasor::Value>
 			}
 		}
 
-		passthrough = inner;
+		if (inner.size() + 3 > spec.size())
+			throw std::format_error("Phasor::Value format spec too long");
+		spec[specLen++] = '{';
+		spec[specLen++] = ':';
+		for (char c : inner) spec[specLen++] = c;
+		spec[specLen++] = '}';
 		return close;
 	}
 
     template <typename FormatContext>
     auto format(const Phasor::Value &v, FormatContext &ctx) const
     {
-        std::string fmtstr;
-        fmtstr.reserve(passthrough.size() + 3);
-        fmtstr += "{:";
-        fmtstr += passthrough;
-        fmtstr += '}';
+        using namespace Phasor;
+
+        // Without a width/fill spec everything streams straight into the output
+        if (specLen == 3)
+            return write(v, ctx.out());
 
         auto fwd = [&]<typename T>(const T &val) {
-            return std::vformat_to(ctx.out(), fmtstr, std::make_format_args(val));
+            return std::vformat_to(ctx.out(), std::string_view(spec.data(), specLen), std::make_format_args(val));
         };
 
+        switch (style)
+        {
+        case Style::Quoted:
+            if (!v.isString())
+                break;
+            [[fallthrough]];
+        case Style::TypeOnly:
+        case Style::TypeValue:
+        case Style::Debug:
+        {
+            std::string text;
+            write(v, std::back_inserter(text));
+            return fwd(text);
+        }
+        case Style::Value:
+        default:
+            break;
+        }
+
+        switch (v.getType())
+        {
+        case ValueType::Null:   return std::format_to(ctx.out(), "null");
+        case ValueType::Bool:   return fwd(v.asBool());
+        case ValueType::Int:    return fwd(v.asInt());
+        case ValueType::Float:  return fwd(v.asFloat());
+        default:
+        {
+            std::string text;
+            write(v, std::back_inserter(text));
+            return fwd(text);
+        }
+        }
+    }
+
+  private:
+    template <typename Out>
+    Out write(const Phasor::Value &v, Out out) const
+    {
         using namespace Phasor;
+        auto put = [&](std::string_view s) { out = std::copy(s.begin(), s.end(), out); };
 
         switch (style)
         {
         case Style::TypeOnly:
-            return fwd(Value::typeToString(v.getType()).asString());
+            put(typeName(v.getType()));
+            return out;
 
         case Style::TypeValue:
-            return fwd(Value::typeToString(v.getType()).asString()
-                       + "(" + escapeString(v.toString()) + ")");
+        {
+            put(typeName(v.getType()));
+            *out++ = '(';
+            std::string text;
+            v.formatTo(std::back_inserter(text));
+            out = escapeTo(text, out);
+            *out++ = ')';
+            return out;
+        }
 
         case Style::Debug:
-            return fwd(debug_repr(v));
+            return writeDebug(v, out);
 
         case Style::Quoted:
             if (v.isString())
-                return fwd("\"" + escapeString(v.asString()) + "\"");
+            {
+                *out++ = '"';
+                out = escapeTo(v.view(), out);
+                *out++ = '"';
+                return out;
+            }
             [[fallthrough]];
 
         case Style::Value:
         default:
             switch (v.getType())
             {
-            case ValueType::Null:   return std::format_to(ctx.out(), "null");
-            case ValueType::Bool:   return fwd(v.asBool());
-            case ValueType::Int:    return fwd(v.asInt());
-            case ValueType::Float:  return fwd(v.asFloat());
-            case ValueType::String: return fwd(debug_repr(escapeString(v.asString())));
-            case ValueType::Array:  return fwd(v.toString());
-            case ValueType::Struct: return fwd(v.toString());
+            case ValueType::Null:   put("null"); return out;
+            case ValueType::Bool:   return std::format_to(out, "{}", v.asBool());
+            case ValueType::Int:    return std::format_to(out, "{}", v.asInt());
+            case ValueType::Float:  return std::format_to(out, "{}", v.asFloat());
+            case ValueType::String:
+            {
+                // Escaped twice, matching the historical debug_repr(escapeString(s)) output
+                std::string once;
+                escapeTo(v.view(), std::back_inserter(once));
+                *out++ = '"';
+                out = escapeTo(once, out);
+                *out++ = '"';
+                return out;
+            }
+            case ValueType::Array:  return v.formatTo(out);
+            case ValueType::Struct: return v.formatTo(out);
+            case ValueType::Map:    return v.formatTo(out);
             }
         }
-        return ctx.out();
+        return out;
     }
 
-  private:
-    static std::string debug_repr(const Phasor::Value &v)
+    template <typename Out>
+    static Out writeDebug(const Phasor::Value &v, Out out)
     {
         using Phasor::ValueType;
+        auto put = [&](std::string_view s) { out = std::copy(s.begin(), s.end(), out); };
+
         switch (v.getType())
         {
-        case ValueType::Null:   return "null";
-        case ValueType::String: return "\"" + escapeString(v.asString()) + "\"";
+        case ValueType::Null:   put("null"); return out;
+        case ValueType::String:
+            *out++ = '"';
+            out = escapeTo(v.view(), out);
+            *out++ = '"';
+            return out;
         case ValueType::Array:
         {
-            const auto &arr = *v.asArray();
-            std::string out = "[";
-            for (std::size_t i = 0; i < arr.size(); ++i)
-            {
-                out += debug_repr(arr[i]);
-                if (i + 1 < arr.size()) out += ", ";
-            }
-            return out + "]";
+            bool first = true;
+            *out++ = '[';
+            v.asArray()->forEach([&](const Phasor::Value &e) {
+                if (!first) put(", ");
+                first = false;
+                out = writeDebug(e, out);
+            });
+            *out++ = ']';
+            return out;
+        }
+        case ValueType::Map:
+        {
+            bool first = true;
+            *out++ = '{';
+            v.asMap()->forEach([&](const Phasor::Value &k, const Phasor::Value &e) {
+                if (!first) put(", ");
+                first = false;
+                out = writeDebug(k, out);
+                put(": ");
+                out = writeDebug(e, out);
+            });
+            *out++ = '}';
+            return out;
         }
         case ValueType::Struct:
         {
             const auto &s = *v.asStruct();
-            std::string out = s.structName + " { ";
-            bool first = true;
-            for (const auto &[k, val] : s.fields)
+            put(s.structName());
+            put(" { ");
+            const auto &names = s.shape->fieldNames();
+            for (std::size_t i = 0; i < names.size(); ++i)
             {
-                if (!first) out += ", ";
-                out += k + ": " + debug_repr(val);
-                first = false;
+                if (i) put(", ");
+                put(names[i]);
+                put(": ");
+                out = writeDebug(s.slots[i], out);
             }
-            return out + " }";
+            put(" }");
+            return out;
         }
-        default: return v.toString();
+        default: return v.formatTo(out);
         }
     }
 
-    static std::string escape(const std::string &s)
+    static constexpr std::string_view typeName(Phasor::ValueType type)
     {
-        std::string out;
-        out.reserve(s.size());
-        for (char c : s)
-            switch (c)
-            {
-            case '"':  out += "\\\""; break;
-            case '\\': out += "\\\\"; break;
-            case '\n': out += "\\n";  break;
-            case '\t': out += "\\t";  break;
-            default:   out += c;
-            }
-        return out;
+        using Phasor::ValueType;
+        switch (type)
+        {
+        case ValueType::Null:   return "null";
+        case ValueType::Bool:   return "bool";
+        case ValueType::Int:    return "int";
+        case ValueType::Float:  return "float";
+        case ValueType::String: return "string";
+        case ValueType::Struct: return "struct";
+        case ValueType::Array:  return "array";
+        case ValueType::Map:    return "map";
+        }
+        return "unknown";
     }
 };
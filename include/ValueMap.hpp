@@ -0,0 +1,10 @@
+#pragma once
+#include "Value.hpp"
+
+namespace Phasor
+{
+
+/// @brief Standalone name for the map storage behind Value maps
+using ValueMap = Value::MapInstance;
+
+} // namespace Phasor